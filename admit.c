@@ -0,0 +1,299 @@
+/**
+ * \file
+ *
+ * \internal
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include <netinet/in.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/admit.h>
+#include <nyanttp/const.h>
+#include <nyanttp/expect.h>
+#include <nyanttp/mem.h>
+#include <nyanttp/util.h>
+
+/**
+ * \brief Admission table slot
+ */
+struct ny_admit_slot {
+	_Atomic uint64_t state; /**< Prefix hash and live connections or zero */
+	_Atomic uint64_t tat; /**< Theoretical arrival time in microseconds */
+};
+
+/**
+ * \brief Mask of slot state counting live connections
+ *
+ * The prefix hash is kept in the bits above, so that a slot is claimed and
+ * counted with a single compare and swap.
+ */
+#define COUNT_MASK ((UINT64_C(1) << NY_ADMIT_COUNT_BITS) - 1)
+
+/**
+ * \brief Mix hash state
+ *
+ * \param[in] hash Hash state
+ *
+ * \return Mixed hash state
+ */
+static ny_const uint64_t mix(uint64_t hash) {
+	hash ^= hash >> 30;
+	hash *= UINT64_C(0xbf58476d1ce4e5b9);
+	hash ^= hash >> 27;
+	hash *= UINT64_C(0x94d049bb133111eb);
+	hash ^= hash >> 31;
+
+	return hash;
+}
+
+/**
+ * \brief Hash address prefix
+ *
+ * \param[in] octets Address
+ * \param[in] length Address length in octets
+ * \param[in] prefix Prefix length in bits
+ *
+ * \return Non-zero prefix hash fitting above the connection count
+ */
+static uint64_t hash_prefix(uint8_t const *restrict octets, size_t length,
+	unsigned prefix) {
+	uint64_t hash = mix(length ^ (uint64_t) prefix << 8);
+
+	for (size_t iter = 0; iter < length && prefix; ++iter) {
+		uint8_t octet = octets[iter];
+
+		/* Mask host bits */
+		if (prefix < 8) {
+			octet &= (uint8_t) (0xff00 >> prefix);
+			prefix = 0;
+		}
+		else
+			prefix -= 8;
+
+		hash = mix(hash ^ octet);
+	}
+
+	/* Zero marks unused slots */
+	return hash >> NY_ADMIT_COUNT_BITS | 1;
+}
+
+/**
+ * \brief Look up or claim admission table slot
+ *
+ * \param[in,out] admit Admission table
+ * \param[in] key Prefix hash
+ * \param[in] now Current time in microseconds
+ *
+ * \return Slot index or \c NY_ADMIT_NONE if the table is full
+ *
+ * Slots without live connections and with a full token bucket are reclaimed.
+ * Reclaiming fails if a connection is counted in the slot meanwhile.
+ */
+static uint32_t slot_get(struct ny_admit *restrict admit, uint64_t key,
+	uint64_t now) {
+	uint32_t stale = NY_ADMIT_NONE;
+	uint64_t stale_state = 0;
+
+	for (uint32_t probe = 0; probe < NY_ADMIT_PROBE; ++probe) {
+		uint32_t idx = (uint32_t) (key + probe) & admit->mask;
+		struct ny_admit_slot *slot = &admit->slots[idx];
+
+		uint64_t cur = atomic_load_explicit(&slot->state,
+			memory_order_acquire);
+
+		/* Claim unused slot */
+		if (!cur) {
+			if (atomic_compare_exchange_strong(&slot->state, &cur,
+				key << NY_ADMIT_COUNT_BITS))
+				return idx;
+		}
+
+		if (cur >> NY_ADMIT_COUNT_BITS == key)
+			return idx;
+
+		if (stale == NY_ADMIT_NONE && !(cur & COUNT_MASK) &&
+			atomic_load_explicit(&slot->tat, memory_order_relaxed) <= now) {
+			stale = idx;
+			stale_state = cur;
+		}
+	}
+
+	/* Reclaim stale slot unless a connection was counted meanwhile */
+	if (stale != NY_ADMIT_NONE) {
+		struct ny_admit_slot *slot = &admit->slots[stale];
+
+		if (atomic_compare_exchange_strong(&slot->state, &stale_state,
+			key << NY_ADMIT_COUNT_BITS))
+			return stale;
+
+		if (stale_state >> NY_ADMIT_COUNT_BITS == key)
+			return stale;
+	}
+
+	return NY_ADMIT_NONE;
+}
+
+int ny_admit_init(struct ny_admit *restrict admit, struct ny *restrict ny,
+	uint32_t number) {
+	assert(admit);
+	assert(ny);
+	assert(number);
+
+	int ret = -1;
+
+	if (unlikely(number > UINT32_C(1) << 30)) {
+		ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, ERANGE);
+		goto exit;
+	}
+
+	/* Round number of slots up to a power of two, keeping some free */
+	uint32_t nslot = 1;
+	while (nslot < 2 * number)
+		nslot <<= 1;
+
+	admit->memsize = ny_util_align(nslot * sizeof (struct ny_admit_slot),
+		ny->page_size);
+
+	/* Shared memory is zeroed, marking all slots unused */
+	admit->slots = ny_mem_alloc_shared(admit->memsize);
+	if (unlikely(!admit->slots)) {
+		ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+		goto exit;
+	}
+
+	admit->mask = nslot - 1;
+	admit->prefix6 = 64;
+	admit->prefix4 = 32;
+	admit->maxcon = 0;
+	admit->rate = 0.0;
+	admit->burst = 1;
+
+	ret = 0;
+
+exit:
+	return ret;
+}
+
+void ny_admit_destroy(struct ny_admit *restrict admit) {
+	assert(admit);
+	assert(admit->slots);
+
+	int _ = ny_mem_free(admit->slots, admit->memsize);
+	assert(!_);
+
+	admit->slots = NULL;
+	admit->memsize = 0;
+}
+
+bool ny_admit_acquire(struct ny_admit *restrict admit,
+	struct sockaddr const *restrict address, ev_tstamp now,
+	uint32_t *restrict slot) {
+	assert(admit);
+	assert(address);
+	assert(slot);
+
+	*slot = NY_ADMIT_NONE;
+
+	uint64_t key;
+	switch (address->sa_family) {
+	case AF_INET6:;
+		uint8_t const *octets =
+			((struct sockaddr_in6 const *) address)->sin6_addr.s6_addr;
+
+		/* Group IPv4-mapped addresses like IPv4 addresses */
+		if (IN6_IS_ADDR_V4MAPPED(
+			&((struct sockaddr_in6 const *) address)->sin6_addr))
+			key = hash_prefix(octets + 12, 4, admit->prefix4);
+		else
+			key = hash_prefix(octets, 16, admit->prefix6);
+		break;
+
+	case AF_INET:
+		key = hash_prefix((uint8_t const *)
+			&((struct sockaddr_in const *) address)->sin_addr, 4,
+			admit->prefix4);
+		break;
+
+	default:
+		return true;
+	}
+
+	uint64_t usec = now * 1e6;
+
+	uint64_t limit = admit->maxcon && admit->maxcon < COUNT_MASK ?
+		admit->maxcon : COUNT_MASK;
+
+	uint32_t idx = NY_ADMIT_NONE;
+
+	/* Count live connection, looking up the slot again if it was reclaimed */
+	for (unsigned retry = 0; idx == NY_ADMIT_NONE; ++retry) {
+		if (unlikely(retry == NY_ADMIT_PROBE))
+			return true;
+
+		idx = slot_get(admit, key, usec);
+		if (unlikely(idx == NY_ADMIT_NONE))
+			return true;
+
+		struct ny_admit_slot *entry = &admit->slots[idx];
+
+		uint64_t state = atomic_load_explicit(&entry->state,
+			memory_order_relaxed);
+		do {
+			if (unlikely(state >> NY_ADMIT_COUNT_BITS != key)) {
+				idx = NY_ADMIT_NONE;
+				break;
+			}
+
+			if ((state & COUNT_MASK) >= limit)
+				return false;
+		} while (!atomic_compare_exchange_weak(&entry->state, &state,
+			state + 1));
+	}
+
+	struct ny_admit_slot *entry = &admit->slots[idx];
+
+	/* Generic cell rate algorithm, only for connections within the limit */
+	if (admit->rate > 0.0) {
+		uint64_t interval = 1e6 / admit->rate;
+		uint64_t tolerance = interval * (admit->burst ? admit->burst - 1 : 0);
+
+		uint64_t tat = atomic_load_explicit(&entry->tat, memory_order_relaxed);
+		uint64_t next;
+		do {
+			uint64_t base = tat > usec ? tat : usec;
+			if (base - usec > tolerance) {
+				ny_admit_release(admit, idx);
+				return false;
+			}
+
+			next = base + interval;
+		} while (!atomic_compare_exchange_weak(&entry->tat, &tat, next));
+	}
+
+	*slot = idx;
+
+	return true;
+}
+
+void ny_admit_release(struct ny_admit *restrict admit, uint32_t slot) {
+	assert(admit);
+
+	if (slot == NY_ADMIT_NONE)
+		return;
+
+	assert(slot <= admit->mask);
+
+	struct ny_admit_slot *entry = &admit->slots[slot];
+
+	/* Never wrap below zero */
+	uint64_t state = atomic_load_explicit(&entry->state, memory_order_relaxed);
+	while ((state & COUNT_MASK) &&
+		!atomic_compare_exchange_weak(&entry->state, &state, state - 1));
+}
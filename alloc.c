@@ -8,6 +8,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdbool.h>
 #include <unistd.h>
 
 #include <sys/mman.h>
@@ -20,10 +21,24 @@
 #include <nyanttp/util.h>
 #include <nyanttp/mem.h>
 
+/**
+ * \brief Growable allocation pool slab state
+ */
+struct ny_alloc_slab {
+	uint32_t live; /**< Number of acquired objects */
+	uint16_t idle; /**< Number of trims without acquired objects */
+	bool used; /**< Objects acquired since slab was last returned */
+	bool trim; /**< To be returned to the system */
+};
+
 static ny_const size_t max(size_t a, size_t b) {
 	return a > b ? a : b;
 }
 
+static ny_const size_t min(size_t a, size_t b) {
+	return a < b ? a : b;
+}
+
 static ny_pure void *index(struct ny_alloc const *restrict alloc, uint32_t idx) {
 	/* Calculate octet offset */
 	size_t offset = alloc->size * idx;
@@ -50,8 +65,81 @@ static ny_pure uint32_t pointer(struct ny_alloc const *restrict alloc, void *ptr
 	return offset / alloc->size;
 }
 
-int ny_alloc_init(struct ny_alloc *restrict alloc, struct ny *restrict ny,
-	uint32_t number, uint16_t size) {
+/**
+ * \brief Binary logarithm of number of objects per slab
+ *
+ * \param[in] size Object size
+ * \param[in] page_size Page size
+ *
+ * \return Binary logarithm of number of objects per slab
+ *
+ * Slabs span whole pages, so that objects never straddle slab boundaries and
+ * the slab of an object follows from its index by a shift.
+ */
+static ny_const uint8_t slab_shift(size_t size, size_t page_size) {
+	uint8_t shift = 0;
+
+	/* Smallest number of objects filling whole pages */
+	while ((size << shift) % page_size)
+		++shift;
+
+	/* Minimum slab size */
+	while ((size << shift) < NY_ALLOC_SLAB)
+		++shift;
+
+	return shift;
+}
+
+/**
+ * \brief Link objects of returned slab into free list
+ *
+ * \param[in,out] alloc Allocation pool
+ * \param[in] slab Slab index
+ */
+static void slab_use(struct ny_alloc *restrict alloc, uint32_t slab) {
+	uint32_t first = slab << alloc->shift;
+	uint32_t last = (uint32_t) min(((size_t) slab + 1) << alloc->shift,
+		alloc->number);
+
+	for (uint32_t iter = last; iter-- > first;) {
+		*(uint32_t *) index(alloc, iter) = alloc->free;
+		alloc->free = iter;
+	}
+
+	alloc->slabs[slab].used = true;
+	alloc->slabs[slab].idle = 0;
+	--alloc->nreturn;
+}
+
+/**
+ * \brief Reuse returned slab
+ *
+ * \param[in,out] alloc Allocation pool
+ */
+static void slab_grow(struct ny_alloc *restrict alloc) {
+	/* Only slabs below the never acquired objects may have been returned */
+	uint32_t end = alloc->next >> alloc->shift;
+
+	for (uint32_t slab = 0; slab < end; ++slab) {
+		if (!alloc->slabs[slab].used) {
+			slab_use(alloc, slab);
+			break;
+		}
+	}
+}
+
+/**
+ * \brief Reserve memory for allocation pool
+ *
+ * \param[out] alloc Allocation pool
+ * \param[in] ny Ny context
+ * \param[in] number Capacity as number of objects
+ * \param[in] size Object size
+ *
+ * \return Zero on success or non-zero on error
+ */
+static int pool_init(struct ny_alloc *restrict alloc, struct ny *restrict ny,
+	uint32_t number, uint16_t size, bool huge) {
 	assert(alloc);
 	assert(ny);
 	assert(number);
@@ -59,7 +147,7 @@ int ny_alloc_init(struct ny_alloc *restrict alloc, struct ny *restrict ny,
 
 	int status = -1;
 
-	if (unlikely(number > UINT32_C(4194304) || size > UINT16_C(1024))) {
+	if (unlikely(number > UINT32_C(4194304) || size > UINT16_C(32768))) {
 		ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, ERANGE);
 		goto exit;
 	}
@@ -68,31 +156,29 @@ int ny_alloc_init(struct ny_alloc *restrict alloc, struct ny *restrict ny,
 	alloc->size = ny_util_align(max(size, sizeof (uint32_t)), sizeof (void *));
 
 	/* Size of memory allocation */
-	alloc->memsize = ny_util_align(number * alloc->size, ny->page_size);
-
-	/* Adjust object number to fill up last page */
-	size_t actual = alloc->memsize / alloc->size;
+	alloc->memsize = ny_util_align((size_t) number * alloc->size,
+		huge ? NY_MEM_HUGE_SIZE : ny->page_size);
 
 	/* Allocate memory for pool */
-	alloc->pool = ny_mem_alloc(alloc->memsize);
+	alloc->pool = huge ? ny_mem_alloc_huge(alloc->memsize) :
+		ny_mem_alloc(alloc->memsize);
 	if (unlikely(!alloc->pool)) {
 		ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
 		goto exit;
 	}
 
-#if NY_ALLOC_ADVISE
-	/* Advise the OS about the access pattern */
-	posix_madvise(alloc->pool, alloc->memsize,
-		POSIX_MADV_SEQUENTIAL | POSIX_MADV_WILLNEED);
-#endif
+	/* Adjust object number to fill up last page */
+	alloc->number = alloc->memsize / alloc->size;
+	alloc->huge = huge;
 
-	/* Initialise free list */
-	alloc->free = 0;
-	for (uint_least32_t iter = 0; iter < actual - 1; ++iter)
-		*(uint32_t *) index(alloc, iter) = iter + 1;
+	alloc->slabs = NULL;
+	alloc->nslab = 0;
+	alloc->nreturn = 0;
+	alloc->shift = 0;
 
-	/* Sentinel */
-	*(uint32_t *) index(alloc, actual - 1) = UINT32_MAX;
+	/* Objects are handed out in order before the free list is used */
+	alloc->free = UINT32_MAX;
+	alloc->next = 0;
 
 	status = 0;
 
@@ -100,6 +186,24 @@ exit:
 	return status;
 }
 
+int ny_alloc_init(struct ny_alloc *restrict alloc, struct ny *restrict ny,
+	uint32_t number, uint16_t size) {
+	int status = pool_init(alloc, ny, number, size, false);
+
+#if NY_ALLOC_ADVISE
+	/* Advise the OS about the access pattern */
+	if (likely(!status))
+		posix_madvise(alloc->pool, alloc->memsize, POSIX_MADV_SEQUENTIAL);
+#endif
+
+	return status;
+}
+
+int ny_alloc_init_huge(struct ny_alloc *restrict alloc,
+	struct ny *restrict ny, uint32_t number, uint16_t size) {
+	return pool_init(alloc, ny, number, size, true);
+}
+
 void ny_alloc_destroy(struct ny_alloc *restrict alloc) {
 	assert(alloc);
 	assert(alloc->pool);
@@ -108,25 +212,144 @@ void ny_alloc_destroy(struct ny_alloc *restrict alloc) {
 	int _;
 
 	/* Free memory pool */
-	_ = ny_mem_free(alloc->pool, alloc->memsize);
+	_ = alloc->huge ? ny_mem_free_huge(alloc->pool, alloc->memsize) :
+		ny_mem_free(alloc->pool, alloc->memsize);
 	assert(!_);
 
 	alloc->pool = NULL;
 	alloc->memsize = 0;
+
+	/* Free slab states */
+	if (alloc->slabs) {
+		_ = ny_mem_free(alloc->slabs,
+			alloc->nslab * sizeof (struct ny_alloc_slab));
+		assert(!_);
+
+		alloc->slabs = NULL;
+		alloc->nslab = 0;
+	}
+}
+
+int ny_alloc_init_grow(struct ny_alloc *restrict alloc,
+	struct ny *restrict ny, uint32_t number, uint16_t size) {
+	int status = pool_init(alloc, ny, number, size, false);
+	if (unlikely(status))
+		goto exit;
+
+	alloc->shift = slab_shift(alloc->size, ny->page_size);
+
+	/* Number of slabs covering the pool */
+	alloc->nslab = ((size_t) alloc->number + (UINT32_C(1) << alloc->shift) - 1) >>
+		alloc->shift;
+
+	/* Zeroed memory marks all slabs unused */
+	alloc->slabs = ny_mem_alloc(alloc->nslab * sizeof (struct ny_alloc_slab));
+	if (unlikely(!alloc->slabs)) {
+		ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+
+		int _ = ny_mem_free(alloc->pool, alloc->memsize);
+		assert(!_);
+
+		alloc->pool = NULL;
+		alloc->memsize = 0;
+		alloc->nslab = 0;
+
+		status = -1;
+		goto exit;
+	}
+
+exit:
+	return status;
+}
+
+void ny_alloc_trim(struct ny_alloc *restrict alloc) {
+	assert(alloc);
+
+#if NY_ALLOC_DECOMMIT
+	if (!alloc->slabs)
+		return;
+
+	bool trim = false;
+
+	/* Slabs holding never acquired objects are left alone */
+	uint32_t end = alloc->next >> alloc->shift;
+
+	/* Find slabs unused for long enough, keeping the first one */
+	for (uint32_t slab = 1; slab < end; ++slab) {
+		struct ny_alloc_slab *state = &alloc->slabs[slab];
+		if (!state->used)
+			continue;
+
+		if (state->live)
+			state->idle = 0;
+		else if (++state->idle >= NY_ALLOC_HYSTERESIS) {
+			state->trim = true;
+			trim = true;
+		}
+	}
+
+	if (!trim)
+		return;
+
+	/* Unlink objects of trimmed slabs from free list */
+	for (uint32_t *link = &alloc->free; *link != UINT32_MAX;) {
+		if (alloc->slabs[*link >> alloc->shift].trim)
+			*link = *(uint32_t *) index(alloc, *link);
+		else
+			link = (uint32_t *) index(alloc, *link);
+	}
+
+	/* Return memory of trimmed slabs */
+	size_t slabsize = (size_t) alloc->size << alloc->shift;
+	for (uint32_t slab = 1; slab < end; ++slab) {
+		struct ny_alloc_slab *state = &alloc->slabs[slab];
+		if (!state->trim)
+			continue;
+
+		size_t offset = slab * slabsize;
+		int _ = madvise(alloc->pool + offset,
+			min(slabsize, alloc->memsize - offset), NY_ALLOC_DECOMMIT);
+		assert(!_);
+
+		state->used = false;
+		state->trim = false;
+		state->idle = 0;
+		++alloc->nreturn;
+	}
+#endif
 }
 
 void *ny_alloc_acquire(struct ny_alloc *restrict alloc) {
 	assert(alloc);
 
 	void *object = NULL;
+	uint32_t idx;
 
-	/* Any objects remaining? */
-	if (likely(alloc->free != UINT32_MAX)) {
+	/* Reuse returned slab before touching memory never acquired */
+	if (alloc->free == UINT32_MAX && alloc->nreturn)
+		slab_grow(alloc);
+
+	if (alloc->free != UINT32_MAX) {
 		/* Pop object from list */
-		object = index(alloc, alloc->free);
+		idx = alloc->free;
+		object = index(alloc, idx);
 		alloc->free = *(uint32_t *) object;
 	}
+	else if (likely(alloc->next < alloc->number)) {
+		/* Hand out object never acquired, touching its memory only now */
+		idx = alloc->next++;
+		object = index(alloc, idx);
 
+		if (alloc->slabs)
+			alloc->slabs[idx >> alloc->shift].used = true;
+	}
+	else
+		goto exit;
+
+	if (alloc->slabs)
+		++alloc->slabs[idx >> alloc->shift].live;
+
+exit:
 	return object;
 }
 
@@ -142,7 +365,12 @@ void ny_alloc_release(struct ny_alloc *restrict alloc, void *restrict object) {
 	}
 #endif
 
+	uint32_t idx = pointer(alloc, object);
+
+	if (alloc->slabs)
+		--alloc->slabs[idx >> alloc->shift].live;
+
 	/* Push object back onto list */
 	*(uint32_t *) object = alloc->free;
-	alloc->free = pointer(alloc, object);
+	alloc->free = idx;
 }
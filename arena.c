@@ -0,0 +1,162 @@
+/**
+ * \file
+ *
+ * \internal
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/alloc.h>
+#include <nyanttp/arena.h>
+#include <nyanttp/expect.h>
+#include <nyanttp/mem.h>
+#include <nyanttp/util.h>
+
+/**
+ * \brief Arena chunk header
+ */
+struct ny_arena_chunk {
+	struct ny_arena_chunk *prev; /**< Previous chunk or null */
+	size_t size; /**< Size of directly mapped memory */
+};
+
+/**
+ * \brief Allocate memory from current chunk
+ *
+ * \param[in,out] arena Arena
+ * \param[in] size Size of memory
+ *
+ * \return Pointer to memory or null if the chunk is exhausted
+ */
+static void *chunk_bump(struct ny_arena *restrict arena, size_t size) {
+	assert(arena->chunk);
+
+	void *memory = NULL;
+
+	uintptr_t base = (uintptr_t) arena->chunk;
+	size_t offset = ny_util_align(base + arena->offset, NY_ARENA_ALIGN) - base;
+
+	if (unlikely(offset > arena->alloc->size ||
+		size > arena->alloc->size - offset))
+		goto exit;
+
+	memory = (uint8_t *) arena->chunk + offset;
+	arena->offset = offset + size;
+
+exit:
+	return memory;
+}
+
+void ny_arena_init(struct ny_arena *restrict arena, struct ny *restrict ny,
+	struct ny_alloc *restrict alloc) {
+	assert(arena);
+	assert(ny);
+	assert(alloc);
+	assert(alloc->size > sizeof (struct ny_arena_chunk) + NY_ARENA_ALIGN);
+
+	arena->ny = ny;
+	arena->alloc = alloc;
+	arena->chunk = NULL;
+	arena->large = NULL;
+	arena->offset = 0;
+}
+
+void *ny_arena_alloc(struct ny_arena *restrict arena, size_t size) {
+	assert(arena);
+
+	void *memory = NULL;
+
+	/* Fast path: bump pointer in current chunk */
+	if (likely(arena->chunk)) {
+		memory = chunk_bump(arena, size);
+		if (likely(memory))
+			goto exit;
+	}
+
+	size_t header = ny_util_align(sizeof (struct ny_arena_chunk),
+		NY_ARENA_ALIGN);
+
+	if (unlikely(size > arena->alloc->size - header - NY_ARENA_ALIGN)) {
+		if (unlikely(size > SIZE_MAX / 2)) {
+			ny_error_set(&arena->ny->error, NY_ERROR_DOMAIN_ERRNO, ENOMEM);
+			goto exit;
+		}
+
+		/* Map memory too large for a chunk directly */
+		struct ny_arena_chunk *large = ny_mem_alloc(header + size);
+		if (unlikely(!large)) {
+			ny_error_set(&arena->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+			goto exit;
+		}
+
+		large->prev = arena->large;
+		large->size = header + size;
+		arena->large = large;
+
+		memory = (uint8_t *) large + header;
+		goto exit;
+	}
+
+	/* Start new chunk */
+	struct ny_arena_chunk *chunk = ny_alloc_acquire(arena->alloc);
+	if (unlikely(!chunk)) {
+		ny_error_set(&arena->ny->error, NY_ERROR_DOMAIN_ERRNO, ENOMEM);
+		goto exit;
+	}
+
+	chunk->prev = arena->chunk;
+	arena->chunk = chunk;
+	arena->offset = sizeof (struct ny_arena_chunk);
+
+	memory = chunk_bump(arena, size);
+	assert(memory);
+
+exit:
+	return memory;
+}
+
+void ny_arena_reset(struct ny_arena *restrict arena) {
+	assert(arena);
+
+	struct ny_arena_chunk *chunk = arena->chunk;
+
+	/* Return all but the first chunk */
+	if (chunk) {
+		while (unlikely(chunk->prev)) {
+			struct ny_arena_chunk *prev = chunk->prev;
+			ny_alloc_release(arena->alloc, chunk);
+			chunk = prev;
+		}
+
+		arena->chunk = chunk;
+		arena->offset = sizeof (struct ny_arena_chunk);
+	}
+
+	/* Unmap large memory */
+	while (unlikely(arena->large)) {
+		struct ny_arena_chunk *large = arena->large;
+		arena->large = large->prev;
+
+		int _ = ny_mem_free(large, large->size);
+		assert(!_);
+	}
+}
+
+void ny_arena_destroy(struct ny_arena *restrict arena) {
+	assert(arena);
+
+	ny_arena_reset(arena);
+
+	/* Return first chunk */
+	if (arena->chunk)
+		ny_alloc_release(arena->alloc, arena->chunk);
+
+	arena->chunk = NULL;
+	arena->offset = 0;
+}
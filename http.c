@@ -7,7 +7,6 @@
 #include "config.h"
 
 #include <assert.h>
-#include <stdlib.h>
 
 #include <nyanttp/ny.h>
 #include <nyanttp/expect.h>
@@ -22,6 +21,20 @@ int ny_http_init(struct ny_http *restrict http,
 	int status = -1;
 
 	http->data = NULL;
+	http->ny = ny;
+
+	/* Initialise request buffer allocator */
+	_ = ny_slab_init(&http->slab, ny, NY_HTTP_SLAB_LIMIT);
+	if (unlikely(_))
+		goto exit;
+
+	/* Initialise request arena chunk pool */
+	_ = ny_alloc_init_grow(&http->arena, ny, NY_HTTP_ARENA_NUMBER,
+		NY_HTTP_ARENA_CHUNK);
+	if (unlikely(_)) {
+		ny_slab_destroy(&http->slab);
+		goto exit;
+	}
 
 	status = 0;
 
@@ -29,6 +42,13 @@ exit:
 	return status;
 }
 
+void ny_http_destroy(struct ny_http *restrict http) {
+	assert(http);
+
+	ny_alloc_destroy(&http->arena);
+	ny_slab_destroy(&http->slab);
+}
+
 int ny_http_con_init(struct ny_http_con *restrict con,
 	struct ny_http *restrict http) {
 	assert(con);
@@ -42,6 +62,18 @@ int ny_http_con_init(struct ny_http_con *restrict con,
 	con->length = 0;
 }
 
+void ny_http_con_destroy(struct ny_http_con *restrict con) {
+	assert(con);
+
+	/* Free request buffer */
+	if (con->buffer)
+		ny_slab_free(&con->http->slab, con->buffer, con->length);
+
+	con->buffer = NULL;
+	con->offset = 0;
+	con->length = 0;
+}
+
 void ny_http_con_readable(struct ny_http_con *restrict con) {
 	assert(con);
 
@@ -51,7 +83,8 @@ void ny_http_con_readable(struct ny_http_con *restrict con) {
 	if (con->length - con->offset <= con->length / 4) {
 		size_t length = con->length ? 2 * con->length : 512;
 		/* FIXME: Error if request too large */
-		uint8_t *buffer = realloc(con->buffer, length);
+		uint8_t *buffer = ny_slab_realloc(&con->http->slab, con->buffer,
+			con->length, length);
 		if (unlikely(!buffer)) {
 			/* TODO: Handle error */
 		}
@@ -74,6 +107,31 @@ void ny_http_con_readable(struct ny_http_con *restrict con) {
 void ny_http_con_writable(struct ny_http_con *restrict con) {
 }
 
+void ny_http_req_init(struct ny_http_req *restrict req,
+	struct ny_http_con *restrict con) {
+	assert(req);
+	assert(con);
+
+	req->data = NULL;
+	req->con = con;
+
+	ny_arena_init(&req->arena, con->http->ny, &con->http->arena);
+}
+
+void ny_http_req_reset(struct ny_http_req *restrict req) {
+	assert(req);
+
+	req->data = NULL;
+
+	ny_arena_reset(&req->arena);
+}
+
+void ny_http_req_destroy(struct ny_http_req *restrict req) {
+	assert(req);
+
+	ny_arena_destroy(&req->arena);
+}
+
 ssize_t ny_http_req_recv(struct ny_http_req *restrict req,
 	void *restrict buffer, size_t length) {
 
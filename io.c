@@ -9,19 +9,234 @@
 #include <assert.h>
 #include <errno.h>
 #include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 
-#if NY_TCP_SENDFILE_LINUX
+#if NY_IO_SENDFILE_LINUX
 #	include <sys/sendfile.h>
-#elif NY_TCP_SENDFILE_BSD
+#elif NY_IO_SENDFILE_BSD
 #	include <sys/uio.h>
 #endif
 
+#if !NY_IO_SENDFILE_LINUX && !NY_IO_SENDFILE_BSD && NY_THREAD
+#	include <pthread.h>
+#endif
+
 #include <nyanttp/expect.h>
+#include <nyanttp/io.h>
+#include <nyanttp/local.h>
+
+#if !NY_IO_SENDFILE_LINUX && !NY_IO_SENDFILE_BSD
+/**
+ * \brief Mapped file window
+ */
+struct map {
+	dev_t dev; /**< Device of mapped file */
+	ino_t ino; /**< Inode of mapped file */
+	struct timespec mtime; /**< Modification time of mapped file */
+	struct timespec ctime; /**< Status change time of mapped file */
+	off_t base; /**< File offset of window */
+	size_t length; /**< Length of window */
+	uint8_t const *memory; /**< Mapped memory or null if unused */
+	unsigned long use; /**< Time of last use */
+	time_t stamp; /**< Monotonic time of last use in seconds */
+};
+
+/**
+ * \brief Mapped file window cache
+ *
+ * Windows stay mapped across calls, so serving a file does not cost a mapping
+ * and an unmapping, with its TLB shootdown, every time.
+ */
+static ny_local struct map map_cache[NY_IO_MAP_CACHE];
+
+/**
+ * \brief Mapped file window cache clock
+ */
+static ny_local unsigned long map_clock;
+
+#if NY_THREAD
+/**
+ * \brief Key whose destructor unmaps the cache of an exiting thread
+ */
+static pthread_key_t map_key;
+
+/**
+ * \brief Key initialisation control
+ */
+static pthread_once_t map_once = PTHREAD_ONCE_INIT;
+
+/**
+ * \brief Cache of this thread registered for cleanup
+ */
+static ny_local bool map_registered;
+#endif
+
+/**
+ * \brief Unmap cached file window
+ *
+ * \param[in,out] map Cache entry
+ */
+static void map_drop(struct map *restrict map) {
+	int _ = munmap((void *) map->memory, map->length);
+	assert(!_);
+
+	map->memory = NULL;
+}
+
+#if NY_THREAD
+/**
+ * \brief Unmap all cached file windows
+ *
+ * \param[in,out] cache Mapped file window cache
+ */
+static void map_flush(void *cache) {
+	for (size_t iter = 0; iter < NY_IO_MAP_CACHE; ++iter) {
+		struct map *entry = (struct map *) cache + iter;
+
+		if (entry->memory)
+			map_drop(entry);
+	}
+}
+
+/**
+ * \brief Create key for cache cleanup
+ */
+static void map_key_init(void) {
+	int _ = pthread_key_create(&map_key, map_flush);
+	assert(!_);
+}
+#endif
+
+/**
+ * \brief Timestamps identifying file contents
+ *
+ * \param[in] st File status
+ * \param[out] mtime Modification time
+ * \param[out] ctime Status change time
+ */
+static void map_times(struct stat const *restrict st,
+	struct timespec *restrict mtime, struct timespec *restrict ctime) {
+#if NY_IO_STAT_NSEC
+	*mtime = st->st_mtim;
+	*ctime = st->st_ctim;
+#else
+	*mtime = (struct timespec) { .tv_sec = st->st_mtime };
+	*ctime = (struct timespec) { .tv_sec = st->st_ctime };
+#endif
+}
+
+/**
+ * \brief Compare timestamps
+ */
+static bool time_equal(struct timespec const *restrict a,
+	struct timespec const *restrict b) {
+	return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+/**
+ * \brief Look up or map file window
+ *
+ * \param[in] fd File descriptor
+ * \param[in] st File status
+ * \param[in] offset File offset within window
+ *
+ * \return Pointer to mapped window or null on error
+ *
+ * Windows are identified by inode and timestamps, so that a file replaced by
+ * one reusing its inode is not served from the old mapping. Windows unused for
+ * \c NY_IO_MAP_TTL seconds are unmapped, so that deleted files are not kept
+ * on disk. The cache of a thread is unmapped once it exits.
+ */
+static struct map *map_get(int fd, struct stat const *restrict st,
+	off_t offset) {
+	off_t base = offset - offset % NY_IO_MAP_WINDOW;
+
+	/* Map window up to end of file */
+	size_t length = NY_IO_MAP_WINDOW;
+	if ((uintmax_t) (st->st_size - base) < length)
+		length = st->st_size - base;
+
+	struct timespec mtime, ctime;
+	map_times(st, &mtime, &ctime);
+
+	struct timespec now;
+	int _ = clock_gettime(CLOCK_MONOTONIC, &now);
+	assert(!_);
+
+#if NY_THREAD
+	/* Unmap cache once this thread exits */
+	if (unlikely(!map_registered)) {
+		_ = pthread_once(&map_once, map_key_init);
+		assert(!_);
+		_ = pthread_setspecific(map_key, map_cache);
+		assert(!_);
+
+		map_registered = true;
+	}
+#endif
+
+	struct map *map = NULL;
+	struct map *victim = &map_cache[0];
+
+	for (size_t iter = 0; iter < NY_IO_MAP_CACHE; ++iter) {
+		struct map *entry = &map_cache[iter];
+
+		/* Release windows unused for long */
+		if (entry->memory && now.tv_sec - entry->stamp > NY_IO_MAP_TTL)
+			map_drop(entry);
+
+		if (!map && entry->memory && entry->dev == st->st_dev &&
+			entry->ino == st->st_ino && entry->base == base &&
+			time_equal(&entry->mtime, &mtime) &&
+			time_equal(&entry->ctime, &ctime))
+			map = entry;
+
+		/* Prefer unused entries, then the least recently used one */
+		if (victim->memory &&
+			(!entry->memory || entry->use < victim->use))
+			victim = entry;
+	}
+
+	/* Remap window if the file size changed */
+	if (map && map->length != length)
+		map_drop(map);
+	else if (!map) {
+		map = victim;
+
+		if (map->memory)
+			map_drop(map);
+	}
+
+	if (!map->memory) {
+		map->memory = ny_io_mmap_ro(fd, length, base);
+		if (unlikely(!map->memory)) {
+			map = NULL;
+			goto exit;
+		}
+
+		map->dev = st->st_dev;
+		map->ino = st->st_ino;
+		map->mtime = mtime;
+		map->ctime = ctime;
+		map->base = base;
+		map->length = length;
+	}
+
+	map->use = ++map_clock;
+	map->stamp = now.tv_sec;
+
+exit:
+	return map;
+}
+#endif
 
 static int fcntl_set(int fd, int get, int set, int flags) {
 	assert(fd >= 0);
@@ -221,21 +436,33 @@ ssize_t ny_io_sendfile(int out, int in, size_t length, off_t offset) {
 #elif NY_IO_SENDFILE_BSD
 	/* BSD‐style sendfile */
 	off_t sbytes;
-	int _ = sendfile(out, in, offset, length, nil, &sbytes, 0);
-	if (likely(!_))
+	int _ = sendfile(in, out, offset, length, NULL, &sbytes, 0);
+	if (likely(!_) || (errno == EAGAIN && sbytes > 0))
 		wlen = sbytes;
 #else
-	/* Emulate sendfile using mmap and write */
-	void *memory = ny_io_mmap_ro(in, length, offset);
-	if (unlikely(!memory))
+	/* Emulate sendfile using cached file mappings and write */
+	struct stat st;
+	if (unlikely(fstat(in, &st)))
+		goto exit;
+
+	/* End of file */
+	if (offset >= st.st_size) {
+		wlen = 0;
 		goto exit;
+	}
 
-	wlen = ny_io_write(out, memory, length);
+	struct map const *map = map_get(in, &st, offset);
+	if (unlikely(!map))
+		goto exit;
 
-	int _ = munmap(memory, length);
-	assert(!_);
-#endif
+	/* Send up to end of window */
+	size_t skip = offset - map->base;
+	if (length > map->length - skip)
+		length = map->length - skip;
+
+	wlen = ny_io_write(out, map->memory + skip, length);
 
 exit:
+#endif
 	return wlen;
 }
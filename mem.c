@@ -12,7 +12,15 @@
 #include <nyanttp/mem.h>
 #include <nyanttp/util.h>
 
-void *ny_mem_alloc(size_t length) {
+/**
+ * \brief Map anonymous memory with guard pages
+ *
+ * \param[in] length Length of memory
+ * \param[in] flags Mapping flags
+ *
+ * \return Pointer to memory or null on error
+ */
+static void *mem_map(size_t length, int flags) {
 	void *memory = NULL;
 
 #if NY_MEM_ALLOC_GUARD
@@ -25,7 +33,7 @@ void *ny_mem_alloc(size_t length) {
 #endif
 
 	void *base = mmap(NULL, alloc, PROT_READ | PROT_WRITE,
-		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		flags | MAP_ANONYMOUS, -1, 0);
 
 	if (unlikely(base == MAP_FAILED))
 		goto exit;
@@ -56,6 +64,14 @@ exit:
 	return memory;
 }
 
+void *ny_mem_alloc(size_t length) {
+	return mem_map(length, MAP_PRIVATE);
+}
+
+void *ny_mem_alloc_shared(size_t length) {
+	return mem_map(length, MAP_SHARED);
+}
+
 int ny_mem_free(void *restrict memory, size_t length) {
 #if NY_MEM_ALLOC_GUARD
 	long pagesize = sysconf(_SC_PAGESIZE);
@@ -70,3 +86,55 @@ int ny_mem_free(void *restrict memory, size_t length) {
 
 	return munmap(base, alloc);
 }
+
+void *ny_mem_alloc_huge(size_t length) {
+	size_t alloc = ny_util_align(length, NY_MEM_HUGE_SIZE);
+	void *memory = NULL;
+
+#if NY_MEM_HUGETLB
+	/* Explicit huge pages are only available if reserved */
+	memory = mmap(NULL, alloc, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+	if (memory != MAP_FAILED)
+		goto exit;
+
+	memory = NULL;
+#endif
+
+	/* Over-allocate to align to huge page boundary */
+	uint8_t *base = mmap(NULL, alloc + NY_MEM_HUGE_SIZE,
+		PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (unlikely(base == MAP_FAILED))
+		goto exit;
+
+	uint8_t *aligned = (uint8_t *) ny_util_align((uintptr_t) base,
+		NY_MEM_HUGE_SIZE);
+
+	int _;
+
+	/* Unmap excess head and tail */
+	if (aligned > base) {
+		_ = munmap(base, aligned - base);
+		assert(!_);
+	}
+
+	_ = munmap(aligned + alloc, base + NY_MEM_HUGE_SIZE - aligned);
+	assert(!_);
+
+#if NY_MEM_THP
+	/* Request transparent huge pages, failure is harmless */
+	_ = madvise(aligned, alloc, MADV_HUGEPAGE);
+	(void) _;
+#endif
+
+	memory = aligned;
+
+exit:
+	return memory;
+}
+
+int ny_mem_free_huge(void *restrict memory, size_t length) {
+	return munmap(memory, ny_util_align(length, NY_MEM_HUGE_SIZE));
+}
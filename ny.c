@@ -8,11 +8,26 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#if NY_AFFINITY
+#	include <sched.h>
+#endif
+
+#if NY_THREAD
+#	include <pthread.h>
+#endif
+
 #include <ev.h>
 
 #include <nyanttp/ny.h>
@@ -34,6 +49,53 @@ char const *ny_version_build() {
 	return NY_VERSION_BUILD;
 }
 
+/**
+ * \brief Finish draining
+ *
+ * \param[in,out] ny Pointer to context structure
+ */
+static void drain_stop(struct ny *restrict ny) {
+	assert(ny);
+
+	ev_prepare_stop(ny->loop, &ny->drain_prepare);
+	ev_timer_stop(ny->loop, &ny->drain_timer);
+	ev_break(ny->loop, EVBREAK_ALL);
+}
+
+static void drain_prepare_event(struct ev_loop *loop,
+	struct ev_prepare *prepare, int revents) {
+	assert(loop);
+	assert(prepare);
+	assert(revents & EV_PREPARE);
+
+	struct ny *ny = (struct ny *) prepare->data;
+
+	/* Wait for busy hooks */
+	for (struct ny_hook *hook = ny->hook; hook; hook = hook->next) {
+		if (hook->busy && hook->busy(hook))
+			return;
+	}
+
+	drain_stop(ny);
+}
+
+static void drain_timer_event(struct ev_loop *loop, struct ev_timer *timer,
+	int revents) {
+	assert(loop);
+	assert(timer);
+	assert(revents & EV_TIMER);
+
+	struct ny *ny = (struct ny *) timer->data;
+
+	/* Deadline passed, finish forcibly */
+	for (struct ny_hook *hook = ny->hook; hook; hook = hook->next) {
+		if (hook->drain)
+			hook->drain(hook, true);
+	}
+
+	drain_stop(ny);
+}
+
 /**
  * \brief Real context initialisation
  *
@@ -62,6 +124,21 @@ int ny_init_(struct ny *restrict ny) {
 
 	ny->page_size = page_size;
 
+	ny->data = NULL;
+	ny->argv = NULL;
+
+	/* No hooks registered yet */
+	ny->hook = NULL;
+
+	/* Do not pin workers by default */
+	ny->affinity = 0;
+
+	ny->drain = false;
+	ev_prepare_init(&ny->drain_prepare, drain_prepare_event);
+	ny->drain_prepare.data = ny;
+	ev_timer_init(&ny->drain_timer, drain_timer_event, NY_DRAIN_TIMEOUT, 0.);
+	ny->drain_timer.data = ny;
+
 	/* Create new event loop */
 	ny->loop = ev_loop_new(EVFLAG_AUTO);
 	if (unlikely(!ny->loop)) {
@@ -83,25 +160,536 @@ void ny_destroy(struct ny *restrict ny) {
 	ny->loop = NULL;
 }
 
+void ny_hook_add(struct ny *restrict ny, struct ny_hook *restrict hook) {
+	assert(ny);
+	assert(hook);
+
+	/* Push hook onto list */
+	hook->next = ny->hook;
+	ny->hook = hook;
+}
+
+void ny_hook_remove(struct ny *restrict ny, struct ny_hook *restrict hook) {
+	assert(ny);
+	assert(hook);
+
+	/* Unlink hook if registered */
+	for (struct ny_hook **iter = &ny->hook; *iter; iter = &(*iter)->next) {
+		if (*iter == hook) {
+			*iter = hook->next;
+			hook->next = NULL;
+			break;
+		}
+	}
+}
+
+void ny_drain(struct ny *restrict ny) {
+	assert(ny);
+
+	if (ny->drain)
+		return;
+
+	ny->drain = true;
+
+	/* Stop accepting new work */
+	for (struct ny_hook *hook = ny->hook; hook; hook = hook->next) {
+		if (hook->drain)
+			hook->drain(hook, false);
+	}
+
+	/* Wait for pending work up to deadline */
+	ev_prepare_start(ny->loop, &ny->drain_prepare);
+	ev_timer_start(ny->loop, &ny->drain_timer);
+}
+
+/**
+ * \brief Pin worker to its CPU set
+ *
+ * \param[in,out] ny Pointer to context structure
+ * \param[in] worker Worker index
+ *
+ * \return Zero on success or non-zero on error
+ */
+static int worker_pin(struct ny *restrict ny, unsigned worker) {
+	assert(ny);
+	assert(ny->affinity);
+
+	int ret = -1;
+
+#if NY_AFFINITY
+	cpu_set_t set;
+
+	/* Determine available CPUs */
+	if (unlikely(sched_getaffinity(0, sizeof set, &set))) {
+		ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+		goto exit;
+	}
+
+	unsigned short cpuv[CPU_SETSIZE];
+	unsigned count = 0;
+	for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if (CPU_ISSET(cpu, &set))
+			cpuv[count++] = cpu;
+	}
+
+	assert(count);
+
+	/* Select consecutive CPUs, wrapping around */
+	unsigned first = (worker * ny->affinity) % count;
+	unsigned number = ny->affinity < count ? ny->affinity : count;
+
+	CPU_ZERO(&set);
+	for (unsigned iter = 0; iter < number; ++iter)
+		CPU_SET(cpuv[(first + iter) % count], &set);
+
+	if (unlikely(sched_setaffinity(0, sizeof set, &set))) {
+		ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+		goto exit;
+	}
+
+	ret = 0;
+#else
+	ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, ENOSYS);
+	goto exit;
+#endif
+
+exit:
+	return ret;
+}
+
+/**
+ * \brief Run worker
+ *
+ * \param[in,out] ny Pointer to context structure
+ * \param[in] worker Worker index
+ * \param[in] setup Worker setup handler or null
+ *
+ * \return Zero on success or non-zero on error
+ */
+static int worker_run(struct ny *restrict ny, unsigned worker,
+	int (*setup)(struct ny *restrict, unsigned)) {
+	assert(ny);
+
+	int ret = -1;
+
+	/* Pin worker before any memory is touched */
+	if (ny->affinity) {
+		if (unlikely(worker_pin(ny, worker)))
+			goto exit;
+	}
+
+	if (setup) {
+		if (unlikely(setup(ny, worker)))
+			goto exit;
+	}
+
+	/* Invoke worker hooks */
+	for (struct ny_hook *hook = ny->hook; hook; hook = hook->next) {
+		if (hook->worker) {
+			if (unlikely(hook->worker(hook, worker)))
+				goto exit;
+		}
+	}
+
+	ev_run(ny->loop, 0);
+
+	ret = 0;
+
+exit:
+	return ret;
+}
+
+int ny_inherit_fd(int fd) {
+	assert(fd >= 0);
+
+	int ret = -1;
+
+	/* Keep file descriptor open across exec */
+	int flags = fcntl(fd, F_GETFD);
+	if (unlikely(flags < 0 || fcntl(fd, F_SETFD, flags & ~FD_CLOEXEC)))
+		goto exit;
+
+	/* Append file descriptor to environment */
+	char value[NY_INHERIT_MAX];
+	char const *list = getenv(NY_ENV_INHERIT);
+	int _ = list
+		? snprintf(value, sizeof value, "%s,%d", list, fd)
+		: snprintf(value, sizeof value, "%d", fd);
+	if (unlikely(_ < 0 || (size_t) _ >= sizeof value)) {
+		errno = E2BIG;
+		goto exit;
+	}
+
+	ret = setenv(NY_ENV_INHERIT, value, 1);
+
+exit:
+	return ret;
+}
+
+int ny_inherit(struct sockaddr const *restrict address, socklen_t addrlen) {
+	assert(address);
+
+	int ret = -1;
+
+	char const *list = getenv(NY_ENV_INHERIT);
+	if (likely(!list))
+		goto exit;
+
+	/* The environment may have been set by anyone */
+	if (unlikely(strlen(list) >= NY_INHERIT_MAX)) {
+		errno = E2BIG;
+		goto exit;
+	}
+
+	char value[NY_INHERIT_MAX];
+	size_t length = 0;
+
+	while (*list) {
+		char *end;
+		long fd = strtol(list, &end, 10);
+		if (unlikely(end == list || fd < 0 || fd > INT_MAX))
+			break;
+
+		list = *end == ',' ? end + 1 : end;
+
+		/* Do not pass inherited file descriptors on to other executables */
+		int flags = fcntl(fd, F_GETFD);
+		if (flags >= 0)
+			fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+
+		/* Compare local address of inherited socket */
+		struct sockaddr_storage local;
+		socklen_t loclen = sizeof local;
+		if (ret < 0 && !getsockname(fd, (struct sockaddr *) &local, &loclen)
+			&& loclen == addrlen && !memcmp(&local, address, addrlen)) {
+			ret = fd;
+			continue;
+		}
+
+		/* Keep other file descriptors listed */
+		int _ = snprintf(value + length, sizeof value - length, "%s%ld",
+			length ? "," : "", fd);
+		assert(_ > 0 && (size_t) _ < sizeof value - length);
+		length += _;
+	}
+
+	if (ret >= 0) {
+		/* Remove socket from environment */
+		if (length)
+			setenv(NY_ENV_INHERIT, value, 1);
+		else
+			unsetenv(NY_ENV_INHERIT);
+	}
+
+exit:
+	return ret;
+}
+
+/**
+ * \brief Close inherited file descriptors nobody has taken over
+ */
+static void inherit_close(void) {
+	char const *list = getenv(NY_ENV_INHERIT);
+	if (likely(!list))
+		return;
+
+	while (*list) {
+		char *end;
+		long fd = strtol(list, &end, 10);
+		if (unlikely(end == list || fd < 0 || fd > INT_MAX))
+			break;
+
+		list = *end == ',' ? end + 1 : end;
+
+		close(fd);
+	}
+
+	unsetenv(NY_ENV_INHERIT);
+}
+
+static void sigterm_event(struct ev_loop *loop, struct ev_signal *signal,
+	int revents) {
+	assert(loop);
+	assert(signal);
+	assert(revents & EV_SIGNAL);
+
+	ny_drain((struct ny *) signal->data);
+}
+
+/**
+ * \brief Run worker process
+ *
+ * \param[in,out] ny Pointer to context structure
+ * \param[in] worker Worker index
+ *
+ * \return Zero on success or non-zero on error
+ */
+static int worker_proc(struct ny *restrict ny, unsigned worker) {
+	assert(ny);
+
+	/* Drain upon termination request */
+	struct ev_signal sigterm;
+	ev_signal_init(&sigterm, sigterm_event, SIGTERM);
+	sigterm.data = ny;
+	ev_signal_start(ny->loop, &sigterm);
+
+	/* Do not keep the worker running for the signal alone */
+	ev_unref(ny->loop);
+
+	int ret = worker_run(ny, worker, NULL);
+
+	ev_ref(ny->loop);
+	ev_signal_stop(ny->loop, &sigterm);
+
+	return ret;
+}
+
+#if NY_MPROC
+struct master;
+
+/**
+ * \brief Supervised worker process
+ */
+struct proc {
+	struct ev_child child; /**< Child watcher */
+	struct ev_timer timer; /**< Respawn timer */
+	struct master *master; /**< Supervisor */
+	ev_tstamp start; /**< Time of last spawn */
+	ev_tstamp backoff; /**< Current respawn delay */
+	unsigned index; /**< Worker index */
+};
+
+/**
+ * \brief Worker supervisor
+ */
+struct master {
+	struct ny *ny; /**< Context structure */
+	struct ev_loop *loop; /**< Supervisor event loop */
+	struct ev_signal sigint; /**< Interrupt signal watcher */
+	struct ev_signal sigterm; /**< Termination signal watcher */
+	struct ev_signal sigusr2; /**< Binary upgrade signal watcher */
+	struct proc *procv; /**< Worker processes */
+	unsigned nproc; /**< Number of worker processes */
+	bool stop; /**< Shutting down */
+};
+
+/**
+ * \brief Restore default signal disposition in a forked child
+ */
+static void signal_reset(void) {
+	int const signals[] = { SIGINT, SIGTERM, SIGUSR2, SIGCHLD };
+
+	sigset_t set;
+	sigemptyset(&set);
+
+	for (size_t iter = 0; iter < sizeof signals / sizeof *signals; ++iter) {
+		signal(signals[iter], SIG_DFL);
+		sigaddset(&set, signals[iter]);
+	}
+
+	/* The supervisor loop may have blocked the signals */
+	sigprocmask(SIG_UNBLOCK, &set, NULL);
+}
+
+/**
+ * \brief Stop supervisor signal watchers
+ *
+ * \param[in,out] master Worker supervisor
+ */
+static void master_signal_stop(struct master *restrict master) {
+	assert(master);
+
+	ev_ref(master->loop);
+	ev_signal_stop(master->loop, &master->sigint);
+	ev_ref(master->loop);
+	ev_signal_stop(master->loop, &master->sigterm);
+	ev_ref(master->loop);
+	ev_signal_stop(master->loop, &master->sigusr2);
+}
+
+/**
+ * \brief Fork worker process
+ *
+ * \param[in,out] proc Worker process
+ *
+ * \return Zero on success or non-zero on error
+ */
+static int proc_spawn(struct proc *restrict proc) {
+	assert(proc);
+
+	struct master *master = proc->master;
+	struct ny *ny = master->ny;
+
+	int ret = -1;
+
+	pid_t pid = fork();
+	if (unlikely(pid < 0)) {
+		ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+		goto exit;
+	}
+	else if (pid == 0) {
+		/* Release signals claimed by the supervisor */
+		master_signal_stop(master);
+		signal_reset();
+
+		/*
+		 * Interrupts from the terminal reach the whole process group, leave
+		 * them to the supervisor, which makes workers drain
+		 */
+		signal(SIGINT, SIG_IGN);
+
+		/* Run event loop in the child */
+		ev_loop_fork(ny->loop);
+		exit(worker_proc(ny, proc->index) ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+
+	/* Setup child watcher */
+	ev_child_set(&proc->child, pid, 0);
+	ev_child_start(master->loop, &proc->child);
+	proc->start = ev_now(master->loop);
+
+	ret = 0;
+
+exit:
+	return ret;
+}
+
+/**
+ * \brief Schedule respawn of worker process
+ *
+ * \param[in,out] proc Worker process
+ */
+static void proc_respawn(struct proc *restrict proc) {
+	assert(proc);
+
+	struct ev_loop *loop = proc->master->loop;
+
+	/* Back off exponentially while the worker keeps crashing */
+	if (ev_now(loop) - proc->start >= NY_RUN_BACKOFF_RESET
+		|| proc->backoff < NY_RUN_BACKOFF_MIN)
+		proc->backoff = NY_RUN_BACKOFF_MIN;
+	else if (proc->backoff < NY_RUN_BACKOFF_MAX / 2.)
+		proc->backoff *= 2.;
+	else
+		proc->backoff = NY_RUN_BACKOFF_MAX;
+
+	ev_timer_set(&proc->timer, proc->backoff, 0.);
+	ev_timer_start(loop, &proc->timer);
+}
+
+static void respawn_event(struct ev_loop *loop, struct ev_timer *timer,
+	int revents) {
+	assert(loop);
+	assert(timer);
+	assert(revents & EV_TIMER);
+
+	struct proc *proc = (struct proc *) timer->data;
+
+	if (unlikely(proc_spawn(proc)))
+		proc_respawn(proc);
+}
+
 static void child_event(struct ev_loop *loop, struct ev_child *child,
 	int revents) {
 	assert(loop);
 	assert(child);
 	assert(revents & EV_CHILD);
 
-	/* TODO: Do something useful */
-	ev_break(loop, EVBREAK_ALL);
+	struct proc *proc = (struct proc *) child->data;
+
+	ev_child_stop(loop, child);
+
+	if (proc->master->stop)
+		return;
+
+	/* Respawn worker unless it finished successfully */
+	if (unlikely(!WIFEXITED(child->rstatus)
+		|| WEXITSTATUS(child->rstatus) != EXIT_SUCCESS))
+		proc_respawn(proc);
+}
+
+/**
+ * \brief Stop supervising and terminate workers
+ *
+ * \param[in,out] master Worker supervisor
+ */
+static void master_stop(struct master *restrict master) {
+	assert(master);
+
+	master->stop = true;
+
+	for (unsigned iter = 0; iter < master->nproc; ++iter) {
+		struct proc *proc = master->procv + iter;
+
+		ev_timer_stop(master->loop, &proc->timer);
+
+		if (ev_is_active(&proc->child))
+			kill(proc->child.pid, SIGTERM);
+	}
+}
+
+static void stop_event(struct ev_loop *loop, struct ev_signal *signal,
+	int revents) {
+	assert(loop);
+	assert(signal);
+	assert(revents & EV_SIGNAL);
+
+	master_stop((struct master *) signal->data);
 }
 
+static void upgrade_event(struct ev_loop *loop, struct ev_signal *signal,
+	int revents) {
+	assert(loop);
+	assert(signal);
+	assert(revents & EV_SIGNAL);
+
+	struct master *master = (struct master *) signal->data;
+	struct ny *ny = master->ny;
+
+	if (unlikely(!ny->argv || master->stop))
+		return;
+
+	pid_t pid = fork();
+	if (unlikely(pid < 0)) {
+		ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+	}
+	else if (pid == 0) {
+		/* Hand listening sockets over to the new executable */
+		for (struct ny_hook *hook = ny->hook; hook; hook = hook->next) {
+			if (hook->exec)
+				hook->exec(hook);
+		}
+
+		/* Tell the new executable whom to retire once it is running */
+		char parent[24];
+		snprintf(parent, sizeof parent, "%ld", (long) getppid());
+		setenv(NY_ENV_PARENT, parent, 1);
+
+		signal_reset();
+		execvp(ny->argv[0], ny->argv);
+		_exit(127);
+	}
+}
+#endif
+
 int ny_run(struct ny *restrict ny, unsigned nproc) {
 	assert(ny);
 	assert(nproc < sysconf(_SC_CHILD_MAX));
 
 	int ret = -1;
 
+	/* Listeners have taken over their inherited sockets by now */
+	inherit_close();
+
 #if NY_MPROC
-	struct ev_child procv[nproc];
-	memset(procv, 0, sizeof procv);
+	struct proc procv[nproc];
+
+	struct master master = {
+		.ny = ny,
+		.procv = procv,
+		.nproc = nproc,
+		.stop = false
+	};
 
 	/* Initialise default event loop */
 	struct ev_loop *loop = ev_default_loop(EVFLAG_AUTO);
@@ -110,44 +698,146 @@ int ny_run(struct ny *restrict ny, unsigned nproc) {
 		goto exit;
 	}
 
+	master.loop = loop;
+
+	/* Signal watchers must not keep the supervisor running */
+	ev_signal_init(&master.sigint, stop_event, SIGINT);
+	ev_signal_init(&master.sigterm, stop_event, SIGTERM);
+	ev_signal_init(&master.sigusr2, upgrade_event, SIGUSR2);
+	master.sigint.data = master.sigterm.data = master.sigusr2.data = &master;
+	ev_signal_start(loop, &master.sigint);
+	ev_unref(loop);
+	ev_signal_start(loop, &master.sigterm);
+	ev_unref(loop);
+	ev_signal_start(loop, &master.sigusr2);
+	ev_unref(loop);
+
 	/* Fork children */
+	ret = 0;
 	for (unsigned iter = 0; iter < nproc; ++iter) {
-		pid_t proc = fork();
-		if (unlikely(proc < 0)) {
-			ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
-			goto reap;
-		}
-		else if (proc == 0) {
-			/* Run event loop in the child */
-			ev_loop_fork(ny->loop);
-			ev_run(ny->loop, 0);
-			exit(EXIT_SUCCESS);
+		struct proc *proc = procv + iter;
+
+		proc->master = &master;
+		proc->backoff = 0.;
+		proc->index = iter;
+
+		ev_child_init(&proc->child, child_event, 0, 0);
+		proc->child.data = proc;
+
+		ev_timer_init(&proc->timer, respawn_event, 0., 0.);
+		proc->timer.data = proc;
+
+		if (unlikely(proc_spawn(proc))) {
+			/* Terminate workers forked so far */
+			master.nproc = iter;
+			master_stop(&master);
+			ret = -1;
+			break;
 		}
+	}
 
-		/* Setup child watcher */
-		ev_child_init(procv + iter, child_event, proc, 0);
-		procv[iter].data = procv + iter;
-		ev_child_start(loop, procv + iter);
+	/* Retire the supervisor that executed this binary */
+	char const *parent = getenv(NY_ENV_PARENT);
+	if (parent) {
+		if (likely(!ret && atol(parent) == (long) getppid()))
+			kill(getppid(), SIGTERM);
+
+		unsetenv(NY_ENV_PARENT);
 	}
 
+	/* Supervise until all workers have finished */
 	ev_run(loop, 0);
+
+	master_signal_stop(&master);
 #else
-	ev_run(ny->loop, 0);
-#endif
+	if (unlikely(worker_proc(ny, 0)))
+		goto exit;
 
 	ret = 0;
+#endif
 
-#if NY_MPROC
-reap:
-	/* Stop watchers and kill children */
-	for (unsigned iter = 0; iter < nproc; ++iter) {
-		if (likely(procv[iter].pid)) {
-			ev_child_stop(loop, procv + iter);
-			kill(procv[iter].pid, SIGTERM);
+exit:
+	return ret;
+}
+
+#if NY_THREAD
+/**
+ * \brief Worker thread
+ */
+struct thread {
+	pthread_t id; /**< Thread identifier */
+	struct ny *parent; /**< Parent context */
+	struct ny ny; /**< Worker context */
+	int (*setup)(struct ny *restrict, unsigned); /**< Setup handler */
+	unsigned index; /**< Worker index */
+	int ret; /**< Return value */
+};
+
+static void *thread_main(void *arg) {
+	struct thread *thread = (struct thread *) arg;
+
+	thread->ret = -1;
+
+	/* Create context with an event loop of its own */
+	if (unlikely(ny_init_(&thread->ny)))
+		goto exit;
+
+	thread->ny.data = thread->parent->data;
+	thread->ny.argv = thread->parent->argv;
+	thread->ny.affinity = thread->parent->affinity;
+
+	thread->ret = worker_run(&thread->ny, thread->index, thread->setup);
+
+	ny_destroy(&thread->ny);
+
+exit:
+	return NULL;
+}
+#endif
+
+int ny_run_threads(struct ny *restrict ny, unsigned nthread,
+	int (*setup)(struct ny *restrict, unsigned)) {
+	assert(ny);
+	assert(setup);
+
+	int ret = -1;
+
+#if NY_THREAD
+	struct thread threadv[nthread];
+
+	/* Start worker threads */
+	unsigned count;
+	for (count = 0; count < nthread; ++count) {
+		struct thread *thread = threadv + count;
+
+		thread->parent = ny;
+		thread->setup = setup;
+		thread->index = count;
+
+		int _ = pthread_create(&thread->id, NULL, thread_main, thread);
+		if (unlikely(_)) {
+			ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, _);
+			break;
 		}
 	}
+
+	if (likely(count == nthread))
+		ret = 0;
+
+	/* Wait for workers to finish */
+	for (unsigned iter = 0; iter < count; ++iter) {
+		int _ = pthread_join(threadv[iter].id, NULL);
+		assert(!_);
+
+		/* Report first worker error */
+		if (unlikely(threadv[iter].ret) && likely(!ret)) {
+			ny->error = threadv[iter].ny.error;
+			ret = -1;
+		}
+	}
+#else
+	ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, ENOSYS);
 #endif
 
-exit:
 	return ret;
 }
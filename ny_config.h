@@ -2,6 +2,35 @@
 #	define NY_MPROC 1
 #endif
 
+#if HAVE_PTHREAD_CREATE
+#	define NY_THREAD 1
+#endif
+
+#if HAVE_SCHED_SETAFFINITY
+#	define NY_AFFINITY 1
+#endif
+
+/* Minimum delay before respawning a failed worker */
+#define NY_RUN_BACKOFF_MIN 0.1
+
+/* Maximum delay before respawning a failed worker */
+#define NY_RUN_BACKOFF_MAX 30.0
+
+/* Uptime after which a failing worker is respawned with minimum delay again */
+#define NY_RUN_BACKOFF_RESET 60.0
+
+/* Deadline for draining workers */
+#define NY_DRAIN_TIMEOUT 30.0
+
+/* Environment variable listing sockets inherited on binary upgrade */
+#define NY_ENV_INHERIT "NY_INHERIT"
+
+/* Environment variable naming the supervisor to retire on binary upgrade */
+#define NY_ENV_PARENT "NY_PARENT"
+
+/* Maximum length of inherited socket list */
+#define NY_INHERIT_MAX 256
+
 /* Define MAP_ANONYMOUS if necessary */
 #if !HAVE_DECL_MAP_ANONYMOUS
 #	define MAP_ANONYMOUS MAP_ANON
@@ -11,16 +40,161 @@
 #	define NY_MEM_ALLOC_GUARD 1
 #endif
 
+/* Explicit huge pages */
+#if HAVE_DECL_MAP_HUGETLB
+#	define NY_MEM_HUGETLB 1
+#endif
+
+/* Transparent huge pages */
+#if HAVE_MADVISE && HAVE_DECL_MADV_HUGEPAGE
+#	define NY_MEM_THP 1
+#endif
+
+/* Huge page size */
+#define NY_MEM_HUGE_SIZE 2097152
+
 #if HAVE_POSIX_MADVISE
 #	define NY_ALLOC_ADVISE 1
 #endif
 
-/* Maximum number of TCP connections to accept per event */
+/* Advice returning unused allocation pool slabs to the system */
+#if HAVE_MADVISE && HAVE_DECL_MADV_FREE
+#	define NY_ALLOC_DECOMMIT MADV_FREE
+#elif HAVE_MADVISE && HAVE_DECL_MADV_DONTNEED
+#	define NY_ALLOC_DECOMMIT MADV_DONTNEED
+#endif
+
+/* Minimum size of growable allocation pool slabs */
+#define NY_ALLOC_SLAB 65536
+
+/* Number of trims a slab must stay unused before it is returned */
+#define NY_ALLOC_HYSTERESIS 6
+
+/* Alignment of arena allocations */
+#define NY_ARENA_ALIGN _Alignof (max_align_t)
+
+#if HAVE_SENDFILE
+#	if HAVE_SYS_SENDFILE_H
+#		define NY_IO_SENDFILE_LINUX 1
+#	else
+#		define NY_IO_SENDFILE_BSD 1
+#	endif
+#endif
+
+/* Size of file windows mapped if native sendfile is unavailable */
+#define NY_IO_MAP_WINDOW (1 << 20)
+
+/* Number of mapped file windows cached per thread */
+#define NY_IO_MAP_CACHE 16
+
+/* Seconds a mapped file window stays cached without being used */
+#define NY_IO_MAP_TTL 10
+
+/* File timestamps with nanosecond resolution */
+#if HAVE_STRUCT_STAT_ST_MTIM && HAVE_STRUCT_STAT_ST_CTIM
+#	define NY_IO_STAT_NSEC 1
+#endif
+
+#if HAVE_DECL_SO_REUSEPORT
+#	define NY_TCP_REUSEPORT 1
+#endif
+
+#if HAVE_DECL_TCP_DEFER_ACCEPT
+#	define NY_TCP_DEFER_ACCEPT 1
+#endif
+
+#if HAVE_DECL_TCP_FASTOPEN
+#	define NY_TCP_FASTOPEN 1
+#endif
+
+#if HAVE_DECL_TCP_INFO
+#	define NY_TCP_INFO 1
+#endif
+
+/* Socket option holding back partial frames */
+#if HAVE_DECL_TCP_CORK
+#	define NY_TCP_CORK TCP_CORK
+#elif HAVE_DECL_TCP_NOPUSH
+#	define NY_TCP_CORK TCP_NOPUSH
+#endif
+
+#if HAVE_DECL_TCP_NOTSENT_LOWAT
+#	define NY_TCP_NOTSENT_LOWAT 1
+#endif
+
+#if HAVE_DECL_TCP_USER_TIMEOUT
+#	define NY_TCP_USER_TIMEOUT 1
+#endif
+
+#if HAVE_DECL_TCP_KEEPIDLE && HAVE_DECL_TCP_KEEPINTVL && HAVE_DECL_TCP_KEEPCNT
+#	define NY_TCP_KEEPALIVE 1
+#endif
+
+#if HAVE_LINUX_ERRQUEUE_H && HAVE_DECL_SO_ZEROCOPY && HAVE_DECL_MSG_ZEROCOPY
+#	define NY_TCP_ZEROCOPY 1
+#endif
+
+#if HAVE_SPLICE
+#	define NY_TCP_SPLICE 1
+#endif
+
+/* Initial number of TCP connections to accept per event */
 #define NY_TCP_ACCEPT_MAX 16
 
+/* Lower bound of adaptive TCP accept batch size */
+#define NY_TCP_ACCEPT_MIN 4
+
+/* Upper bound of adaptive TCP accept batch size */
+#define NY_TCP_ACCEPT_LIMIT 256
+
+/* Event loop lag above which the TCP accept batch size is reduced */
+#define NY_TCP_ACCEPT_LAG 0.002
+
+/* Size of TCP output queue segments */
+#define NY_TCP_SEG_SIZE 1024
+
+/* Number of TCP output queue segments per connection */
+#define NY_TCP_SEG_CON 16
+
+/* Size of lent TCP receive buffers */
+#define NY_TCP_BUF_SIZE 4096
+
+/* Number of TCP connections per lent receive buffer */
+#define NY_TCP_BUF_SHARE 4
+
+/* Maximum number of TCP output queue segments per write */
+#define NY_TCP_IOV_MAX IOV_MAX
+
+/* Minimum payload size for zero-copy transmission */
+#define NY_TCP_ZEROCOPY_MIN 16384
+
+/* Maximum number of file octets sent per connection and event */
+#define NY_TCP_SENDFILE_CHUNK 262144
+
+/* Maximum number of octets to move into a relay pipe at once */
+#define NY_TCP_SPLICE_MAX 65536
+
+/* Maximum number of octets relayed per connection and event */
+#define NY_TCP_SPLICE_CHUNK 262144
+
+/* Maximum number of admission table slots probed per lookup */
+#define NY_ADMIT_PROBE 8
+
+/* Bits of admission table slot state counting live connections */
+#define NY_ADMIT_COUNT_BITS 24
+
+/* Minimum interval between TCP_INFO samples of a connection */
+#define NY_TCP_INFO_INTERVAL 1.0
+
 /* TCP connection activity timeout */
 #define NY_TCP_TIMEOUT 60.0
 
+/* Interval between TCP memory pool trims */
+#define NY_TCP_TRIM_INTERVAL 10.0
+
+/* TCP timing wheel tick interval */
+#define NY_TCP_WHEEL_TICK 1.0
+
 /* TCP accept event priority */
 #define NY_TCP_ACCEPT_PRIO EV_MINPRI
 
@@ -30,5 +204,14 @@
 /* TCP I/O event priority */
 #define NY_TCP_IO_PRIO 0
 
+/* Octets of address space reserved per HTTP buffer size class */
+#define NY_HTTP_SLAB_LIMIT (UINT32_C(64) << 20)
+
+/* Size of HTTP request arena chunks */
+#define NY_HTTP_ARENA_CHUNK 4096
+
+/* Maximum number of HTTP request arena chunks */
+#define NY_HTTP_ARENA_NUMBER 16384
+
 /* TLS default cipher priorities */
 #define NY_TLS_DEFAULT_PRIO "PFS:-3DES-CBC:-ARCFOUR-128:-SHA1:+COMP-DEFLATE:-VERS-SSL3.0:-VERS-TLS1.0:-VERS-DTLS1.0:-SIGN-RSA-SHA1:-SIGN-DSA-SHA1:-SIGN-ECDSA-SHA1:%LATEST_RECORD_VERSION:%SAFE_RENEGOTIATION:%STATELESS_COMPRESSION"
@@ -0,0 +1,102 @@
+/**
+ * \file
+ *
+ * \brief Connection admission control
+ */
+
+#pragma once
+#ifndef __ny_admit__
+#define __ny_admit__
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/socket.h>
+
+#include <ev.h>
+
+#include <nyanttp/ny.h>
+
+/**
+ * \brief Admission table slot of untracked connections
+ */
+#define NY_ADMIT_NONE UINT32_MAX
+
+struct ny_admit_slot;
+
+/**
+ * \brief Admission table
+ *
+ * Counts live connections and limits the connection rate per source address
+ * prefix. The table lives in shared memory, so workers started by ny_run()
+ * after initialisation update a common view without locking.
+ */
+struct ny_admit {
+	struct ny_admit_slot *slots; /**< Hash table slots */
+	size_t memsize; /**< Size of memory allocation */
+	uint32_t mask; /**< Number of slots minus one */
+	unsigned prefix6; /**< IPv6 prefix length grouping sources */
+	unsigned prefix4; /**< IPv4 prefix length grouping sources */
+	uint32_t maxcon; /**< Live connections per prefix or zero for no limit */
+	double rate; /**< Connections per second per prefix or zero for no limit */
+	unsigned burst; /**< Connections per prefix exceeding the rate at once */
+};
+
+/**
+ * \brief Initialise admission table
+ *
+ * \param[out] admit Admission table
+ * \param[in] ny Ny context
+ * \param[in] number Number of prefixes tracked at once
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * Groups sources by /64 IPv6 and /32 IPv4 prefixes without limits, which may
+ * be changed before use.
+ */
+extern int ny_admit_init(struct ny_admit *restrict admit,
+	struct ny *restrict ny, uint32_t number);
+
+/**
+ * \brief Destroy admission table
+ *
+ * \param[in,out] admit Admission table
+ */
+extern void ny_admit_destroy(struct ny_admit *restrict admit);
+
+/**
+ * \brief Admit connection
+ *
+ * \param[in,out] admit Admission table
+ * \param[in] address Source address
+ * \param[in] now Current time
+ * \param[out] slot Slot to release once the connection is closed
+ *
+ * \return Whether to admit the connection
+ *
+ * Connections from other than IP sources, or whose prefix does not fit into
+ * the table, are admitted untracked with slot \c NY_ADMIT_NONE. Connections
+ * rejected for the connection limit do not use up rate budget.
+ */
+extern bool ny_admit_acquire(struct ny_admit *restrict admit,
+	struct sockaddr const *restrict address, ev_tstamp now,
+	uint32_t *restrict slot);
+
+/**
+ * \brief Release admitted connection
+ *
+ * \param[in,out] admit Admission table
+ * \param[in] slot Slot returned by ny_admit_acquire()
+ */
+extern void ny_admit_release(struct ny_admit *restrict admit, uint32_t slot);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif
@@ -12,16 +12,26 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
 #include <stdint.h>
 
+struct ny_alloc_slab;
+
 /**
  * \brief Allocation pool
  */
 struct ny_alloc {
 	uint8_t *pool; /**< Object pool */
 	size_t memsize; /**< Size of memory allocation */
+	struct ny_alloc_slab *slabs; /**< Slab states or null if not growable */
+	uint32_t nslab; /**< Number of slabs */
+	uint32_t nreturn; /**< Number of slabs returned to the system */
 	uint32_t free; /**< Index of first free object */
+	uint32_t next; /**< Index of first object never acquired */
+	uint32_t number; /**< Number of objects */
 	uint16_t size; /**< Object size */
+	uint8_t shift; /**< Binary logarithm of number of objects per slab */
+	bool huge; /**< Pool backed by huge pages */
 };
 
 /**
@@ -33,10 +43,57 @@ struct ny_alloc {
  * \param[in] size Object size
  *
  * \return Zero on success or non-zero on error
+ *
+ * Address space for the full capacity is reserved, but memory is only touched
+ * as objects are first acquired.
  */
 extern int ny_alloc_init(struct ny_alloc *restrict alloc,
 	struct ny *restrict ny, uint32_t number, uint16_t size);
 
+/**
+ * \brief Initialise growable allocation pool
+ *
+ * \param[out] alloc Allocation pool
+ * \param[in] ny Ny context
+ * \param[in] number Capacity as number of objects
+ * \param[in] size Object size
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * Like ny_alloc_init(), but slabs of at least \c NY_ALLOC_SLAB octets that are
+ * no longer used are handed back to the system by ny_alloc_trim().
+ */
+extern int ny_alloc_init_grow(struct ny_alloc *restrict alloc,
+	struct ny *restrict ny, uint32_t number, uint16_t size);
+
+/**
+ * \brief Initialise allocation pool backed by huge pages
+ *
+ * \param[out] alloc Allocation pool
+ * \param[in] ny Ny context
+ * \param[in] number Capacity as number of objects
+ * \param[in] size Object size
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * Like ny_alloc_init(), but the pool is rounded up to the huge page size and
+ * backed by huge pages where available to reduce TLB pressure. The capacity is
+ * extended to fill the last huge page. Meant for large, long-lived pools.
+ */
+extern int ny_alloc_init_huge(struct ny_alloc *restrict alloc,
+	struct ny *restrict ny, uint32_t number, uint16_t size);
+
+/**
+ * \brief Return unused memory of growable allocation pool
+ *
+ * \param[in,out] alloc Allocation pool
+ *
+ * To be called periodically. Slabs without acquired objects over
+ * \c NY_ALLOC_HYSTERESIS consecutive calls are handed back to the system. Does
+ * nothing for pools that are not growable.
+ */
+extern void ny_alloc_trim(struct ny_alloc *restrict alloc);
+
 /**
  * \brief Destroy allocation pool
  *
@@ -0,0 +1,84 @@
+/**
+ * \file
+ *
+ * \brief Bump arena allocator
+ */
+
+#pragma once
+#ifndef __ny_arena__
+#define __ny_arena__
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/alloc.h>
+
+struct ny_arena_chunk;
+
+/**
+ * \brief Bump arena allocator
+ *
+ * Hands out memory from chunks acquired from an allocation pool, one pool
+ * object per chunk. Memory is not freed individually, but all at once by
+ * ny_arena_reset().
+ */
+struct ny_arena {
+	struct ny *ny; /**< Ny context */
+	struct ny_alloc *alloc; /**< Chunk pool */
+	struct ny_arena_chunk *chunk; /**< Current chunk or null */
+	struct ny_arena_chunk *large; /**< Directly mapped allocations */
+	size_t offset; /**< Offset of free memory in current chunk */
+};
+
+/**
+ * \brief Initialise arena
+ *
+ * \param[out] arena Arena
+ * \param[in] ny Ny context
+ * \param[in] alloc Chunk pool
+ *
+ * No chunk is acquired before the first allocation.
+ */
+extern void ny_arena_init(struct ny_arena *restrict arena,
+	struct ny *restrict ny, struct ny_alloc *restrict alloc);
+
+/**
+ * \brief Allocate memory
+ *
+ * \param[in,out] arena Arena
+ * \param[in] size Size of memory
+ *
+ * \return Pointer to memory suitably aligned for any type or null on error
+ *
+ * Memory that does not fit into a chunk is mapped directly.
+ */
+extern void *ny_arena_alloc(struct ny_arena *restrict arena, size_t size);
+
+/**
+ * \brief Free all memory of arena
+ *
+ * \param[in,out] arena Arena
+ *
+ * The first chunk is kept for reuse, so resetting takes constant time unless
+ * further chunks or directly mapped memory were needed.
+ */
+extern void ny_arena_reset(struct ny_arena *restrict arena);
+
+/**
+ * \brief Destroy arena
+ *
+ * \param[in,out] arena Arena
+ *
+ * Frees all memory and returns all chunks to the pool.
+ */
+extern void ny_arena_destroy(struct ny_arena *restrict arena);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif
@@ -13,6 +13,8 @@ extern "C" {
 #include <nyanttp/ny.h>
 #include <nyanttp/error.h>
 #include <nyanttp/alloc.h>
+#include <nyanttp/arena.h>
+#include <nyanttp/slab.h>
 #include <nyanttp/tcp.h>
 
 struct ny_http;
@@ -24,12 +26,16 @@ struct ny_http_req;
  */
 struct ny_http {
 	void *data; /**< User data */
+	struct ny *ny; /**< Context structure */
 
 	void (*req_readable)(struct ny_http_req *restrict);
 	void (*req_writable)(struct ny_http_req *restrict);
 
 	ssize_t (*recv)(void *restrict, void *restrict, size_t);
 	ssize_t (*send)(void *restrict, void const *restrict, size_t);
+
+	struct ny_slab slab; /**< Request buffer allocator */
+	struct ny_alloc arena; /**< Request arena chunk pool */
 };
 
 /**
@@ -52,18 +58,51 @@ struct ny_http_con {
 struct ny_http_req {
 	void *data; /**< User data */
 	struct ny_http_con *con; /**< HTTP connection */
+	struct ny_arena arena; /**< Request memory */
 };
 
 extern int ny_http_init(struct ny_http *restrict http,
 	struct ny *restrict ny);
 
+extern void ny_http_destroy(struct ny_http *restrict http);
+
 extern int ny_http_con_init(struct ny_http_con *restrict con,
 	struct ny_http *restrict http);
 
+extern void ny_http_con_destroy(struct ny_http_con *restrict con);
+
 extern void ny_http_con_readable(struct ny_http_con *restrict con);
 
 extern void ny_http_con_writable(struct ny_http_con *restrict con);
 
+/**
+ * \brief Initialise HTTP request context
+ *
+ * \param[out] req HTTP request context
+ * \param[in] con HTTP connection
+ *
+ * Memory needed while processing the request is taken from \c req->arena and
+ * lives until the request is reset or destroyed.
+ */
+extern void ny_http_req_init(struct ny_http_req *restrict req,
+	struct ny_http_con *restrict con);
+
+/**
+ * \brief Reset HTTP request context for the next request
+ *
+ * \param[in,out] req HTTP request context
+ *
+ * Frees all request memory at once, keeping the first arena chunk.
+ */
+extern void ny_http_req_reset(struct ny_http_req *restrict req);
+
+/**
+ * \brief Destroy HTTP request context
+ *
+ * \param[in,out] req HTTP request context
+ */
+extern void ny_http_req_destroy(struct ny_http_req *restrict req);
+
 extern ssize_t ny_http_req_recv(struct ny_http_req *restrict req,
 	void *restrict buffer, size_t length);
 
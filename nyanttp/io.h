@@ -72,6 +72,21 @@ extern int ny_io_accept(int lsock, struct sockaddr *restrict address,
 
 extern void *ny_io_mmap_ro(int fd, size_t length, off_t offset);
 
+/**
+ * \brief Send file contents
+ *
+ * \param[in] out Output file descriptor
+ * \param[in] in Input file descriptor
+ * \param[in] length Number of octets to send
+ * \param[in] offset Input file offset
+ *
+ * \return Number of octets sent, zero at end of file or a negative integer
+ *   on error
+ *
+ * Uses the native \c sendfile if available. Otherwise, file windows are mapped
+ * and kept in a small per-thread cache, and fewer octets than requested may be
+ * sent at window boundaries.
+ */
 extern ssize_t ny_io_sendfile(int out, int in, size_t length, off_t offset);
 
 #if defined __cplusplus
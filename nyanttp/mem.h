@@ -15,8 +15,44 @@ extern "C" {
 #include <stddef.h>
 
 extern void *ny_mem_alloc(size_t length);
+
+/**
+ * \brief Allocate memory shared with child processes
+ *
+ * \param[in] length Length of memory
+ *
+ * \return Pointer to zeroed memory or null on error
+ *
+ * The memory stays shared with processes forked afterwards and is freed with
+ * ny_mem_free().
+ */
+extern void *ny_mem_alloc_shared(size_t length);
 extern int ny_mem_free(void *restrict memory, size_t length);
 
+/**
+ * \brief Allocate memory backed by huge pages
+ *
+ * \param[in] length Length of memory
+ *
+ * \return Pointer to zeroed memory or null on error
+ *
+ * The length is rounded up to the huge page size. Explicit huge pages are
+ * used if the system has reserved them, otherwise huge page aligned memory is
+ * mapped and advised for transparent huge pages. No guard pages are set up.
+ * The memory must be freed with ny_mem_free_huge().
+ */
+extern void *ny_mem_alloc_huge(size_t length);
+
+/**
+ * \brief Free memory allocated by ny_mem_alloc_huge()
+ *
+ * \param[in] memory Pointer to memory
+ * \param[in] length Length of memory as passed to ny_mem_alloc_huge()
+ *
+ * \return Zero on success or non-zero on error
+ */
+extern int ny_mem_free_huge(void *restrict memory, size_t length);
+
 #if defined __cplusplus
 }
 #endif
@@ -0,0 +1,130 @@
+/**
+ * \file
+ *
+ * \brief Size class allocator
+ */
+
+#pragma once
+#ifndef __ny_slab__
+#define __ny_slab__
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/alloc.h>
+
+/**
+ * \brief Smallest size class
+ */
+#define NY_SLAB_MIN 64
+
+/**
+ * \brief Largest size class
+ */
+#define NY_SLAB_MAX 32768
+
+/**
+ * \brief Number of size classes
+ *
+ * Size classes are the powers of two from \c NY_SLAB_MIN to \c NY_SLAB_MAX.
+ */
+#define NY_SLAB_CLASSES 10
+
+/**
+ * \brief Size class
+ */
+struct ny_slab_class {
+	struct ny_alloc alloc; /**< Object pool */
+	uint64_t nalloc; /**< Number of allocations */
+	uint64_t nfail; /**< Number of failed allocations */
+	uint32_t live; /**< Number of live objects */
+	uint32_t peak; /**< Maximum number of live objects */
+};
+
+/**
+ * \brief Size class allocator
+ */
+struct ny_slab {
+	struct ny *ny; /**< Ny context */
+	struct ny_slab_class classes[NY_SLAB_CLASSES]; /**< Size classes */
+	uint64_t nlarge; /**< Number of allocations above largest class */
+	size_t large; /**< Octets allocated above largest class */
+};
+
+/**
+ * \brief Initialise size class allocator
+ *
+ * \param[out] slab Size class allocator
+ * \param[in] ny Ny context
+ * \param[in] limit Octets reserved per size class
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * Each size class is a growable allocation pool, so memory is only used as
+ * objects are allocated.
+ */
+extern int ny_slab_init(struct ny_slab *restrict slab, struct ny *restrict ny,
+	size_t limit);
+
+/**
+ * \brief Destroy size class allocator
+ *
+ * \param[in,out] slab Size class allocator
+ */
+extern void ny_slab_destroy(struct ny_slab *restrict slab);
+
+/**
+ * \brief Return unused memory of size class allocator
+ *
+ * \param[in,out] slab Size class allocator
+ *
+ * To be called periodically, see ny_alloc_trim().
+ */
+extern void ny_slab_trim(struct ny_slab *restrict slab);
+
+/**
+ * \brief Allocate memory
+ *
+ * \param[in,out] slab Size class allocator
+ * \param[in] size Size of memory
+ *
+ * \return Pointer to memory or null on error
+ *
+ * Memory larger than the largest size class is mapped directly.
+ */
+extern void *ny_slab_alloc(struct ny_slab *restrict slab, size_t size);
+
+/**
+ * \brief Resize memory
+ *
+ * \param[in,out] slab Size class allocator
+ * \param[in] memory Memory or null
+ * \param[in] old Current size of memory
+ * \param[in] size New size of memory
+ *
+ * \return Pointer to resized memory or null on error, leaving \p memory
+ *   untouched
+ */
+extern void *ny_slab_realloc(struct ny_slab *restrict slab,
+	void *restrict memory, size_t old, size_t size);
+
+/**
+ * \brief Free memory
+ *
+ * \param[in,out] slab Size class allocator
+ * \param[in] memory Memory
+ * \param[in] size Size of memory as allocated
+ */
+extern void ny_slab_free(struct ny_slab *restrict slab, void *restrict memory,
+	size_t size);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif
@@ -7,21 +7,79 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stdint.h>
 
+#include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netdb.h>
 
 #include <ev.h>
 
 #include <nyanttp/ny.h>
 #include <nyanttp/error.h>
 #include <nyanttp/alloc.h>
+#include <nyanttp/admit.h>
 
 #define NY_TCP_READABLE EV_READ
 #define NY_TCP_WRITABLE EV_WRITE
 
+/**
+ * \brief Number of timing wheel buckets
+ *
+ * Must exceed the connection timeout in timing wheel ticks.
+ */
+#define NY_TCP_WHEEL_SIZE 64
+
+/**
+ * \brief Maximum number of listening sockets per TCP listener
+ */
+#define NY_TCP_SOCK_MAX 8
+
+/**
+ * \brief Maximum number of idle relay pipes kept per TCP context
+ */
+#define NY_TCP_PIPE_MAX 16
+
+/**
+ * \brief Number of TCP statistics histogram buckets
+ *
+ * Bucket zero counts zero values, bucket \e n counts values of at least
+ * 2^(\e n − 1) and below 2^\e n and the last bucket counts all larger values.
+ */
+#define NY_TCP_HIST_SIZE 32
+
 struct ny_tcp;
 struct ny_tcp_con;
+struct ny_tcp_seg;
+struct ny_tcp_upstream;
+struct ny_tcp_relay;
+
+/**
+ * \brief Listening socket
+ */
+struct ny_tcp_sock {
+	struct ev_io io; /**< I/O watcher */
+	struct addrinfo *res; /**< Resolved addresses not yet bound */
+	struct sockaddr_storage address; /**< Bound address */
+	socklen_t addrlen; /**< Length of bound address */
+};
+
+/**
+ * \brief TCP connection socket options
+ *
+ * Zero members leave the system default in place.
+ */
+struct ny_tcp_opt {
+	bool nodelay; /**< Send segments without delay */
+	int sndbuf; /**< Send buffer size in octets */
+	int rcvbuf; /**< Receive buffer size in octets */
+	int notsent_lowat; /**< Unsent octets below which a socket is writable */
+	int keepalive; /**< Idle seconds before sending keep-alive probes */
+	int keepintvl; /**< Seconds between keep-alive probes */
+	int keepcnt; /**< Number of unanswered keep-alive probes tolerated */
+	unsigned user_timeout; /**< Milliseconds data may stay unacknowledged */
+};
 
 /**
  * \brief TCP listener context
@@ -30,11 +88,37 @@ struct ny_tcp {
 	void *data; /**< User data */
 	struct ny *ny; /**< Context structure */
 	struct ny_alloc alloc_con; /**< Connection memory pool */
-	struct ev_io io; /**< I/O watcher */
+	struct ny_alloc alloc_seg; /**< Output segment memory pool */
+	struct ny_alloc alloc_relay; /**< Relay memory pool */
+	struct ny_alloc alloc_buf; /**< Lent receive buffer memory pool */
+	struct ny_tcp_con *starved; /**< Connections waiting for a lent buffer */
+	struct ny_tcp_con **starved_last; /**< Link to append to starved list */
+	int pipes[NY_TCP_PIPE_MAX][2]; /**< Idle relay pipes */
+	unsigned npipe; /**< Number of idle relay pipes */
+	uint_least32_t maxcon; /**< Maximum number of connections per worker */
+	uint32_t ncon; /**< Number of live connections */
+	pid_t pid; /**< Process owning the memory pools */
+	struct ny_tcp_con *wheel[NY_TCP_WHEEL_SIZE]; /**< Timing wheel buckets */
+	uint32_t tick; /**< Current timing wheel tick */
+	struct ev_timer timer; /**< Timing wheel watcher */
+	unsigned accept_max; /**< Current accept batch size */
+	bool paused; /**< Listener paused as connection pool is exhausted */
+	struct ny_tcp_con *dirty; /**< Connections with output to flush */
+	struct ev_prepare flush; /**< Output flush watcher */
+	struct ev_timer trim; /**< Pool trim watcher */
+	struct ny_tcp_sock sock[NY_TCP_SOCK_MAX]; /**< Listening sockets */
+	unsigned nsock; /**< Number of listening sockets */
+	struct ny_hook hook; /**< Worker hook */
+	bool reuseport; /**< Open a separate listening socket in every worker */
+	bool edge; /**< Edge-triggered connection events */
+	int defer_accept; /**< Seconds to wait for data before accepting */
+	int fastopen; /**< TCP Fast Open queue length */
+	struct ny_tcp_opt opt; /**< Options applied to TCP connections */
+	struct ny_admit *admit; /**< Admission table or null */
 	void (*tcp_error)(struct ny_tcp *restrict,
 		struct ny_error const *restrict);
 	bool (*tcp_connect)(struct ny_tcp *restrict,
-		struct sockaddr_in6 const *restrict); /**< Connect event handler */
+		struct sockaddr const *restrict, socklen_t); /**< Connect event handler */
 
 	void (*con_error)(struct ny_tcp_con *restrict,
 		struct ny_error const *restrict);
@@ -43,19 +127,84 @@ struct ny_tcp {
 	void (*con_readable)(struct ny_tcp_con *restrict);
 	void (*con_writable)(struct ny_tcp_con *restrict);
 	bool (*con_timeout)(struct ny_tcp_con *restrict);
+	void (*con_relayed)(struct ny_tcp_con *restrict,
+		struct ny_error const *restrict); /**< Relay end handler */
 	int goat; /**< Reserve file descriptor */
 };
 
+/**
+ * \brief TCP connection information sample
+ */
+struct ny_tcp_info {
+	ev_tstamp stamp; /**< Time of sample */
+	uint32_t rtt; /**< Smoothed round-trip time in microseconds */
+	uint32_t rttvar; /**< Round-trip time variation in microseconds */
+	uint32_t retrans; /**< Total number of retransmitted segments */
+	uint32_t cwnd; /**< Congestion window in segments */
+	uint32_t unacked; /**< Number of unacknowledged segments */
+};
+
+/**
+ * \brief TCP statistics across connections
+ */
+struct ny_tcp_stats {
+	uint32_t ncon; /**< Number of connections sampled */
+	uint32_t rtt[NY_TCP_HIST_SIZE]; /**< Round-trip time histogram */
+	uint32_t retrans[NY_TCP_HIST_SIZE]; /**< Retransmission histogram */
+	uint32_t cwnd[NY_TCP_HIST_SIZE]; /**< Congestion window histogram */
+	uint32_t unacked[NY_TCP_HIST_SIZE]; /**< Unacknowledged segments histogram */
+};
+
 /**
  * \brief TCP connection context
  */
 struct ny_tcp_con {
 	void *data; /**< User data */
 	struct ny_tcp *tcp; /**< TCP listener */
-	struct ev_timer timer; /**< Timeout watcher */
+	struct ny_tcp_con **prev; /**< Link to this connection in timing wheel */
+	struct ny_tcp_con *next; /**< Next connection in timing wheel bucket */
+	uint32_t touched; /**< Timing wheel tick of last activity */
+	struct ny_tcp_seg *out; /**< First output queue segment */
+	struct ny_tcp_seg *last; /**< Last output queue segment */
+	size_t queued; /**< Number of octets in output queue */
+	struct ny_tcp_con **dirty_prev; /**< Link to this connection in flush list */
+	struct ny_tcp_con *dirty_next; /**< Next connection in flush list */
+	struct ny_tcp_seg *inflight; /**< Sent zero-copy segments not completed */
+	struct ny_tcp_seg *inflight_last; /**< Last sent zero-copy segment */
+	uint32_t zerocopy_seq; /**< Number of next zero-copy send */
+	uint32_t zerocopy_done; /**< Number of zero-copy sends completed */
+	int zerocopy; /**< Zero-copy enabled if positive, unsupported or turned off if negative */
+	int events; /**< Requested events */
+	bool blocked; /**< Output queue waiting for socket to become writable */
+	bool connecting; /**< Outbound connection not yet established */
+	struct ny_tcp_upstream *upstream; /**< Upstream pool */
+	struct ny_tcp_con **idle_prev; /**< Link to this connection in idle list */
+	struct ny_tcp_con *idle_next; /**< Next idle connection */
+	struct ny_tcp_relay *relay; /**< Relay from this connection */
+	struct ny_tcp_relay *relay_in; /**< Relay into this connection */
+	struct ny_tcp_info info; /**< Last connection information sample */
+	uint32_t admit; /**< Admission table slot */
+	uint8_t *lent; /**< Lent receive buffer */
+	size_t lent_start; /**< Offset of first unconsumed octet */
+	size_t lent_end; /**< Offset past last received octet */
+	struct ny_tcp_con **starved_prev; /**< Link to this connection in starved list */
+	struct ny_tcp_con *starved_next; /**< Next starved connection */
 	struct ev_io io; /**< I/O watcher */
 };
 
+/**
+ * \brief Upstream connection pool
+ */
+struct ny_tcp_upstream {
+	void *data; /**< User data */
+	struct ny_tcp *tcp; /**< TCP context providing connections */
+	struct sockaddr_storage address; /**< Upstream address */
+	socklen_t addrlen; /**< Length of upstream address */
+	struct ny_tcp_con *idle; /**< Idle connections, most recently used first */
+	unsigned nidle; /**< Number of idle connections */
+	unsigned maxidle; /**< Maximum number of idle connections */
+};
+
 
 
 /**
@@ -66,11 +215,57 @@ struct ny_tcp_con {
  * \param[in] node Host name or address
  * \param[in] service Service name or port number
  * \param[in] maxcon Maximum number of connections per worker
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * The address is resolved but not bound until ny_tcp_listen() is called, so
+ * listener options may be set and further addresses added in between. If both
+ * \p node and \p service are null, no address is added.
+ *
+ * Every worker forked by ny_run() recreates the memory pools of a listening
+ * context, so that they are private to the worker. The worker fails with
+ * \c EBUSY if connections are open at that point. Contexts initialised in the
+ * process running the worker, as by the setup handler of ny_run_threads(),
+ * keep their pools and sockets.
  */
 extern int ny_tcp_init(struct ny_tcp *restrict tcp, struct ny *restrict ny,
 	char const *restrict node, char const *restrict service,
 	uint_least32_t maxcon);
 
+/**
+ * \brief Add listening address
+ *
+ * \param[in,out] tcp Pointer to TCP listener
+ * \param[in] node Host name or address
+ * \param[in] service Service name or port number
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * Connections on all addresses of a listener share its connection pool and
+ * event handlers. IPv4 addresses are handled as IPv4-mapped IPv6 addresses. If
+ * a listener has several addresses, IPv6 sockets do not accept IPv4
+ * connections, so that IPv4 and IPv6 wildcard addresses may be bound side by
+ * side. Must be called before ny_tcp_listen().
+ */
+extern int ny_tcp_bind(struct ny_tcp *restrict tcp,
+	char const *restrict node, char const *restrict service);
+
+/**
+ * \brief Add listening UNIX domain socket
+ *
+ * \param[in,out] tcp Pointer to TCP listener
+ * \param[in] path Socket path name
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * Connections on the socket are handled like TCP connections. A stale socket
+ * file nobody listens on is replaced. The socket is shared between workers
+ * even if \c reuseport is set, and TCP specific options do not apply. Must be
+ * called before ny_tcp_listen().
+ */
+extern int ny_tcp_bind_unix(struct ny_tcp *restrict tcp,
+	char const *restrict path);
+
 /**
  * \brief Destroy TCP context
  *
@@ -78,12 +273,118 @@ extern int ny_tcp_init(struct ny_tcp *restrict tcp, struct ny *restrict ny,
  */
 extern void ny_tcp_destroy(struct ny_tcp *restrict tcp);
 
+/**
+ * \brief Start listening
+ *
+ * \param[in,out] tcp Pointer to TCP listener
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * Bind the listening sockets, each to the first usable address its node and
+ * service resolved to, and start accepting connections. If \c reuseport is
+ * set, the sockets are bound with \c SO_REUSEPORT and every worker started by
+ * ny_run() opens listening sockets of its own, letting the kernel distribute
+ * incoming connections between the workers. Listeners set up per thread by
+ * ny_run_threads() must set \c reuseport to share an address, otherwise all
+ * but the first fail with \c EADDRINUSE.
+ *
+ * If \c defer_accept is non-zero, connections are only reported once data
+ * has arrived or the given number of seconds has passed. If \c fastopen is
+ * non-zero, TCP Fast Open is enabled with the given number of pending
+ * connections. Either fails with \c ENOPROTOOPT if unsupported.
+ *
+ * The options in \c opt are applied to every accepted and outbound TCP
+ * connection. Options unsupported by the system are ignored.
+ *
+ * If \c admit is set, connections are checked against the admission table
+ * before \c tcp_connect is raised and closed right away if not admitted. The
+ * table should be initialised before ny_run() to be shared by all workers.
+ */
 extern int ny_tcp_listen(struct ny_tcp *restrict tcp);
 
+/**
+ * \brief Open outbound connection
+ *
+ * \param[in,out] tcp Pointer to TCP context
+ * \param[in] address Remote address
+ * \param[in] addrlen Address length
+ *
+ * \return Connection or null on error
+ *
+ * The connection is taken from the connection pool of \p tcp and uses its
+ * event handlers, so \p tcp may be a listener or a context initialised
+ * without address. Connecting does not block: \c con_connect is raised once
+ * the connection is established and \c con_error if it fails. Output may be
+ * queued in the meantime.
+ */
+extern struct ny_tcp_con *ny_tcp_connect(struct ny_tcp *restrict tcp,
+	struct sockaddr const *restrict address, socklen_t addrlen);
+
 extern void ny_tcp_con_destroy(struct ny_tcp_con *restrict con);
 
 extern void ny_tcp_con_touch(struct ny_tcp_con *restrict con);
 
+/**
+ * \brief Hold back partial frames
+ *
+ * \param[in,out] con Connection
+ * \param[in] cork Whether to hold back partial frames
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * While corked, the kernel only sends full frames, so that a response
+ * assembled from several writes leaves in as few frames as possible.
+ * Uncorking sends what is held back right away. Fails with \c ENOSYS if
+ * unsupported.
+ */
+extern int ny_tcp_con_cork(struct ny_tcp_con *restrict con, bool cork);
+
+/**
+ * \brief Sample connection information
+ *
+ * \param[in,out] con Connection
+ *
+ * \return Pointer to sample or null on error
+ *
+ * The kernel is queried with \c TCP_INFO at most once per
+ * \c NY_TCP_INFO_INTERVAL seconds per connection, returning the previous
+ * sample in between. Fails with \c ENOSYS if \c TCP_INFO is unsupported.
+ */
+extern struct ny_tcp_info const *ny_tcp_con_info(
+	struct ny_tcp_con *restrict con);
+
+/**
+ * \brief Collect statistics across connections
+ *
+ * \param[in,out] tcp Pointer to TCP context
+ * \param[out] stats Statistics
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * All live connections except those not yet established or not using TCP are
+ * sampled as by ny_tcp_con_info() and counted in the histograms of \p stats.
+ * Connections that cannot be sampled are skipped without error.
+ */
+extern int ny_tcp_stats(struct ny_tcp *restrict tcp,
+	struct ny_tcp_stats *restrict stats);
+
+/**
+ * \brief Set requested events
+ *
+ * \param[in,out] con Connection
+ * \param[in] events Bitwise or of \c NY_TCP_READABLE and \c NY_TCP_WRITABLE
+ *
+ * While output is queued, \c con_writable is only raised once the output
+ * queue has been written completely. Setting an unchanged event mask does not
+ * touch the event backend.
+ *
+ * If \c edge is set on the listener, connections remain readable until they
+ * are destroyed, whether or not \c NY_TCP_READABLE is requested, and handlers
+ * are expected to read until no data is left. Write
+ * interest is armed automatically when a send function finds the socket full
+ * and disarmed again after \c con_writable was raised once, so this function
+ * need not be called.
+ */
 extern void ny_tcp_con_events(struct ny_tcp_con *restrict con, 
 	int events);
 
@@ -93,15 +394,205 @@ extern ssize_t ny_tcp_con_recv(struct ny_tcp_con *restrict con,
 extern ssize_t ny_tcp_con_recv_vec(struct ny_tcp_con *restrict con,
 	struct iovec const *restrict vector, size_t count);
 
+/**
+ * \brief Receive data into lent buffer
+ *
+ * \param[in,out] con Connection
+ * \param[out] data Received data not yet consumed
+ *
+ * \return Number of octets available, zero if none or a negative integer on
+ *   error
+ *
+ * Data is received into a page-sized buffer lent from a pool of the TCP
+ * context, so that idle connections hold no receive buffer. Data not consumed
+ * with ny_tcp_con_recv_done() is returned again, followed by data received
+ * since. Unconsumed data does not raise \c con_readable again. Fails with
+ * \c ENOBUFS if no buffer is available. In that case, \c con_readable is not
+ * raised again until a buffer has been returned to the pool.
+ */
+extern ssize_t ny_tcp_con_recv_lent(struct ny_tcp_con *restrict con,
+	uint8_t const **restrict data);
+
+/**
+ * \brief Consume data received into lent buffer
+ *
+ * \param[in,out] con Connection
+ * \param[in] length Number of octets consumed
+ *
+ * The buffer is returned to the pool once all data is consumed.
+ */
+extern void ny_tcp_con_recv_done(struct ny_tcp_con *restrict con,
+	size_t length);
+
 extern ssize_t ny_tcp_con_send(struct ny_tcp_con *restrict con,
 	void const *restrict buffer, size_t length);
 
 extern ssize_t ny_tcp_con_send_vec(struct ny_tcp_con *restrict con,
 	struct iovec const *restrict vector, size_t count);
 
+/**
+ * \brief Queue data for sending
+ *
+ * \param[in,out] con Connection
+ * \param[in] buffer Data
+ * \param[in] length Length of data
+ *
+ * \return Zero on success or non-zero if the segment pool is exhausted
+ *
+ * Data is copied into the output queue of the connection. Queued output of
+ * all connections is written once per event loop iteration, coalescing small
+ * writes into a single system call. Must not be mixed with the unbuffered
+ * send functions while output is queued.
+ */
+extern int ny_tcp_con_write(struct ny_tcp_con *restrict con,
+	void const *restrict buffer, size_t length);
+
+/**
+ * \brief Queue data vector for sending
+ *
+ * \param[in,out] con Connection
+ * \param[in] vector Data vector
+ * \param[in] count Number of vector elements
+ *
+ * \return Zero on success or non-zero if the segment pool is exhausted
+ *
+ * Either all or none of the data is queued.
+ */
+extern int ny_tcp_con_write_vec(struct ny_tcp_con *restrict con,
+	struct iovec const *restrict vector, size_t count);
+
+/**
+ * \brief Queue data for sending without copying
+ *
+ * \param[in,out] con Connection
+ * \param[in] buffer Data
+ * \param[in] length Length of data
+ * \param[in] release Release handler
+ * \param[in] arg Release handler argument
+ *
+ * \return Zero on success or non-zero if the segment pool is exhausted
+ *
+ * Large payloads are sent with \c MSG_ZEROCOPY where supported, so the buffer
+ * must remain unchanged until \p release is called once the kernel is done
+ * with it or the connection is destroyed. Small payloads are copied and
+ * released right away. If the kernel runs out of option memory for zero-copy
+ * sends, the connection falls back to copying. On error, \p release is not
+ * called.
+ */
+extern int ny_tcp_con_write_zerocopy(struct ny_tcp_con *restrict con,
+	void const *restrict buffer, size_t length, void (*release)(void *),
+	void *arg);
+
+/**
+ * \brief Relay data between connections
+ *
+ * \param[in,out] src Source connection
+ * \param[in,out] dst Destination connection
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * Data arriving on \p src is moved to \p dst through a pipe with \c splice,
+ * without passing through user space. Reading from \p src is suspended while
+ * \p dst does not take the data, and \c con_readable is not raised for \p src
+ * while relaying. Output queued on \p dst is sent first. Data is moved in
+ * chunks, so that a fast peer does not hold up other connections. The
+ * \c con_relayed
+ * handler of the source is raised with null error at the end of stream, or
+ * with an error if either side fails or \p dst is destroyed. Fails with
+ * \c ENOSYS if \c splice is unsupported.
+ */
+extern int ny_tcp_con_relay(struct ny_tcp_con *restrict src,
+	struct ny_tcp_con *restrict dst);
+
+/**
+ * \brief Relay data from connection into file
+ *
+ * \param[in,out] src Source connection
+ * \param[in] fd Destination file
+ * \param[in] offset Offset in destination file
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * Like ny_tcp_con_relay(), but writes to \p fd starting at \p offset.
+ */
+extern int ny_tcp_con_relay_file(struct ny_tcp_con *restrict src, int fd,
+	off_t offset);
+
+/**
+ * \brief Queue file contents for sending
+ *
+ * \param[in,out] con Connection
+ * \param[in] fd File descriptor
+ * \param[in] length Number of octets to send
+ * \param[in] offset File offset
+ * \param[in] release Release handler or null
+ * \param[in] arg Release handler argument
+ *
+ * \return Zero on success or non-zero if the segment pool is exhausted
+ *
+ * The file is sent with \c sendfile in chunks, so that large files do not
+ * hold up other connections. \p fd must stay open until \p release is called
+ * once the contents are sent or the connection is destroyed. On error,
+ * \p release is not called.
+ */
+extern int ny_tcp_con_write_file(struct ny_tcp_con *restrict con, int fd,
+	size_t length, off_t offset, void (*release)(void *), void *arg);
+
 extern ssize_t ny_tcp_con_sendfile(struct ny_tcp_con *restrict con,
 	int fd, size_t length, off_t offset);
 
+/**
+ * \brief Initialise upstream connection pool
+ *
+ * \param[out] upstream Upstream pool
+ * \param[in,out] tcp Pointer to TCP context providing connections
+ * \param[in] node Host name or address
+ * \param[in] service Service name or port number
+ * \param[in] maxidle Maximum number of idle connections
+ *
+ * \return Zero on success or non-zero on error
+ */
+extern int ny_tcp_upstream_init(struct ny_tcp_upstream *restrict upstream,
+	struct ny_tcp *restrict tcp, char const *restrict node,
+	char const *restrict service, unsigned maxidle);
+
+/**
+ * \brief Destroy upstream connection pool
+ *
+ * \param[in,out] upstream Upstream pool
+ *
+ * Idle connections are closed. Connections in use must have been released or
+ * destroyed before.
+ */
+extern void ny_tcp_upstream_destroy(struct ny_tcp_upstream *restrict upstream);
+
+/**
+ * \brief Acquire upstream connection
+ *
+ * \param[in,out] upstream Upstream pool
+ *
+ * \return Connection or null on error
+ *
+ * The most recently released idle connection still alive is reused. Otherwise
+ * a new connection is opened as by ny_tcp_connect().
+ */
+extern struct ny_tcp_con *ny_tcp_upstream_acquire(
+	struct ny_tcp_upstream *restrict upstream);
+
+/**
+ * \brief Release upstream connection for reuse
+ *
+ * \param[in,out] con Connection acquired from an upstream pool
+ *
+ * The connection is kept idle unless output is pending, it is not yet
+ * established, the pool is full or the worker is draining, in which case it is
+ * destroyed. Idle connections are destroyed without raising further events
+ * when the peer closes them, sends unsolicited data, they time out or the
+ * worker starts draining. The destroy handler
+ * is raised with null user data.
+ */
+extern void ny_tcp_upstream_release(struct ny_tcp_con *restrict con);
+
 #if defined __cplusplus
 }
 #endif
@@ -0,0 +1,171 @@
+/**
+ * \file
+ *
+ * \internal
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/alloc.h>
+#include <nyanttp/const.h>
+#include <nyanttp/expect.h>
+#include <nyanttp/mem.h>
+#include <nyanttp/slab.h>
+
+/**
+ * \brief Size class of memory
+ *
+ * \param[in] size Size of memory
+ *
+ * \return Size class index or \c NY_SLAB_CLASSES if too large
+ */
+static ny_const unsigned slab_class(size_t size) {
+	unsigned class = 0;
+
+	for (size_t limit = NY_SLAB_MIN; limit < size && class < NY_SLAB_CLASSES;
+		limit <<= 1)
+		++class;
+
+	return class;
+}
+
+int ny_slab_init(struct ny_slab *restrict slab, struct ny *restrict ny,
+	size_t limit) {
+	assert(slab);
+	assert(ny);
+	assert(limit >= NY_SLAB_MAX);
+
+	int ret = -1;
+
+	slab->ny = ny;
+	slab->nlarge = 0;
+	slab->large = 0;
+
+	unsigned class;
+	for (class = 0; class < NY_SLAB_CLASSES; ++class) {
+		struct ny_slab_class *entry = &slab->classes[class];
+		size_t size = (size_t) NY_SLAB_MIN << class;
+
+		/* Allocation pool limit */
+		size_t number = limit / size;
+		if (number > UINT32_C(4194304))
+			number = UINT32_C(4194304);
+
+		int _ = ny_alloc_init_grow(&entry->alloc, ny, number, size);
+		if (unlikely(_))
+			goto destroy;
+
+		entry->nalloc = 0;
+		entry->nfail = 0;
+		entry->live = 0;
+		entry->peak = 0;
+	}
+
+	ret = 0;
+	goto exit;
+
+destroy:
+	while (class--)
+		ny_alloc_destroy(&slab->classes[class].alloc);
+
+exit:
+	return ret;
+}
+
+void ny_slab_destroy(struct ny_slab *restrict slab) {
+	assert(slab);
+
+	for (unsigned class = 0; class < NY_SLAB_CLASSES; ++class)
+		ny_alloc_destroy(&slab->classes[class].alloc);
+}
+
+void ny_slab_trim(struct ny_slab *restrict slab) {
+	assert(slab);
+
+	for (unsigned class = 0; class < NY_SLAB_CLASSES; ++class)
+		ny_alloc_trim(&slab->classes[class].alloc);
+}
+
+void *ny_slab_alloc(struct ny_slab *restrict slab, size_t size) {
+	assert(slab);
+
+	void *memory;
+
+	unsigned class = slab_class(size);
+	if (unlikely(class == NY_SLAB_CLASSES)) {
+		/* Map large memory directly */
+		memory = ny_mem_alloc(size);
+		if (unlikely(!memory)) {
+			ny_error_set(&slab->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+			goto exit;
+		}
+
+		++slab->nlarge;
+		slab->large += size;
+		goto exit;
+	}
+
+	struct ny_slab_class *entry = &slab->classes[class];
+
+	memory = ny_alloc_acquire(&entry->alloc);
+	if (unlikely(!memory)) {
+		++entry->nfail;
+		ny_error_set(&slab->ny->error, NY_ERROR_DOMAIN_ERRNO, ENOMEM);
+		goto exit;
+	}
+
+	++entry->nalloc;
+	if (++entry->live > entry->peak)
+		entry->peak = entry->live;
+
+exit:
+	return memory;
+}
+
+void *ny_slab_realloc(struct ny_slab *restrict slab, void *restrict memory,
+	size_t old, size_t size) {
+	assert(slab);
+
+	if (!memory)
+		return ny_slab_alloc(slab, size);
+
+	/* Size class fits already */
+	unsigned class = slab_class(size);
+	if (class < NY_SLAB_CLASSES && class == slab_class(old))
+		return memory;
+
+	void *resized = ny_slab_alloc(slab, size);
+	if (unlikely(!resized))
+		goto exit;
+
+	memcpy(resized, memory, old < size ? old : size);
+	ny_slab_free(slab, memory, old);
+
+exit:
+	return resized;
+}
+
+void ny_slab_free(struct ny_slab *restrict slab, void *restrict memory,
+	size_t size) {
+	assert(slab);
+	assert(memory);
+
+	unsigned class = slab_class(size);
+	if (unlikely(class == NY_SLAB_CLASSES)) {
+		int _ = ny_mem_free(memory, size);
+		assert(!_);
+
+		slab->large -= size;
+		return;
+	}
+
+	struct ny_slab_class *entry = &slab->classes[class];
+
+	ny_alloc_release(&entry->alloc, memory);
+	--entry->live;
+}
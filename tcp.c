@@ -9,16 +9,24 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <sys/socket.h>
+#include <sys/un.h>
+#if NY_TCP_ZEROCOPY
+#	include <linux/errqueue.h>
+#endif
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <netdb.h>
 
 #include <nyanttp/ny.h>
+#include <nyanttp/const.h>
 #include <nyanttp/expect.h>
 #include <nyanttp/tcp.h>
 #include <nyanttp/io.h>
@@ -35,6 +43,36 @@ static struct addrinfo const hints = {
 	.ai_protocol = IPPROTO_TCP
 };
 
+/**
+ * \brief Output queue segment
+ */
+struct ny_tcp_seg {
+	struct ny_tcp_seg *next; /**< Next segment */
+	uint8_t const *base; /**< Payload or null for file contents */
+	size_t start; /**< Offset of first unsent octet */
+	size_t end; /**< Offset past last queued octet */
+	int fd; /**< File descriptor of file contents */
+	off_t offset; /**< File offset of file contents */
+	void (*release)(void *); /**< Release handler of referenced payload */
+	void *arg; /**< Release handler argument */
+	uint32_t seq; /**< Last zero-copy send covering the payload */
+	uint8_t data[]; /**< Copied payload */
+};
+
+/**
+ * \brief Relay through pipe
+ */
+struct ny_tcp_relay {
+	struct ny_tcp_con *src; /**< Source connection */
+	struct ny_tcp_con *dst; /**< Destination connection */
+	int fd; /**< Destination file if no destination connection */
+	off_t offset; /**< Destination file offset */
+	int pipe[2]; /**< Pipe */
+	size_t pending; /**< Number of octets in pipe */
+	bool eof; /**< Source at end of stream */
+	bool wait; /**< Waiting for destination to become writable */
+};
+
 static int goat_new() {
 	int goat = fcntl(0, F_DUPFD, 0);
 	assert(goat >= 0);
@@ -45,11 +83,11 @@ static int goat_new() {
 	return goat;
 }
 
-static int accept_safe(struct ny_tcp *restrict tcp,
+static int accept_safe(struct ny_tcp *restrict tcp, int lsock,
 	struct sockaddr *restrict address, socklen_t *restrict addrlen) {
 	int _;
 
-	int csock = ny_io_accept(tcp->io.fd, address, addrlen);
+	int csock = ny_io_accept(lsock, address, addrlen);
 
 	/* Reject connection if out of file descriptors */
 	if (unlikely(csock < 0 && (errno == EMFILE || errno == ENFILE))) {
@@ -57,7 +95,7 @@ static int accept_safe(struct ny_tcp *restrict tcp,
 		_ = ny_io_close(tcp->goat);
 		assert(!_);
 
-		csock = ny_io_accept(tcp->io.fd, address, addrlen);
+		csock = ny_io_accept(lsock, address, addrlen);
 		if (likely(csock >= 0))
 			ny_io_close(csock);
 
@@ -68,282 +106,2255 @@ static int accept_safe(struct ny_tcp *restrict tcp,
 	return csock;
 }
 
-static void con_event(EV_P_ struct ev_io *io, int revents) {
-	struct ny_tcp_con *con = (struct ny_tcp_con *) io->data;
+/**
+ * \brief Payload capacity of output queue segments
+ *
+ * \return Number of octets
+ */
+static ny_const size_t seg_capacity() {
+	return NY_TCP_SEG_SIZE - offsetof (struct ny_tcp_seg, data);
+}
 
-	if (unlikely(revents & EV_ERROR)) {
-		struct ny_error error;
-		ny_error_set(&error, NY_ERROR_DOMAIN_NY, NY_ERROR_EVWATCH);
-		con->tcp->con_error(con, &error);
+/**
+ * \brief Number of output queue segments per listener
+ *
+ * \param[in] maxcon Maximum number of connections
+ *
+ * \return Number of segments
+ */
+static ny_const uint32_t seg_number(uint_least32_t maxcon) {
+	uint_least64_t number = (uint_least64_t) maxcon * NY_TCP_SEG_CON;
+
+	/* Allocation pool limit */
+	return number < UINT32_C(4194304) ? number : UINT32_C(4194304);
+}
+
+/**
+ * \brief Number of lent receive buffers per listener
+ *
+ * \param[in] maxcon Maximum number of connections
+ *
+ * \return Number of buffers
+ */
+static ny_const uint32_t buf_number(uint_least32_t maxcon) {
+	return maxcon / NY_TCP_BUF_SHARE + 1;
+}
+
+/**
+ * \brief Apply requested events to I/O watcher
+ *
+ * \param[in,out] con Connection
+ */
+static void con_arm(struct ny_tcp_con *restrict con) {
+	int events = con->events;
+
+	/* Connections stay readable in edge-triggered mode */
+	if (con->tcp->edge)
+		events |= EV_READ;
+
+	/* Wait for socket to become writable while output is queued */
+	if (con->blocked)
+		events |= EV_WRITE;
+
+	/* Only read from relay source while the pipe is empty */
+	if (con->relay)
+		events = con->relay->pending ? events & ~EV_READ : events | EV_READ;
+
+	/* Wait for relay destination to take data from the pipe */
+	if (con->relay_in && con->relay_in->wait)
+		events |= EV_WRITE;
+
+	/* Do not read while waiting for a lent receive buffer */
+	if (con->starved_prev)
+		events &= ~EV_READ;
+
+	/* Avoid redundant event backend updates */
+	if (likely(ev_is_active(&con->io)) &&
+		(con->io.events & (EV_READ | EV_WRITE)) == events)
+		return;
+
+	ev_io_stop(con->tcp->ny->loop, &con->io);
+	ev_io_set(&con->io, con->io.fd, events);
+	ev_io_start(con->tcp->ny->loop, &con->io);
+}
+
+/**
+ * \brief Link connection into starved list
+ *
+ * \param[in,out] con Connection
+ */
+static void starved_link(struct ny_tcp_con *restrict con) {
+	struct ny_tcp *tcp = con->tcp;
+
+	con->starved_next = NULL;
+	con->starved_prev = tcp->starved_last;
+	*tcp->starved_last = con;
+	tcp->starved_last = &con->starved_next;
+}
+
+/**
+ * \brief Unlink connection from starved list
+ *
+ * \param[in,out] con Connection
+ */
+static void starved_unlink(struct ny_tcp_con *restrict con) {
+	*con->starved_prev = con->starved_next;
+	if (con->starved_next)
+		con->starved_next->starved_prev = con->starved_prev;
+	else
+		con->tcp->starved_last = con->starved_prev;
+	con->starved_prev = NULL;
+}
+
+/**
+ * \brief Return lent receive buffer to pool
+ *
+ * \param[in,out] con Connection
+ */
+static void lent_return(struct ny_tcp_con *restrict con) {
+	struct ny_tcp *tcp = con->tcp;
+
+	ny_alloc_release(&tcp->alloc_buf, con->lent);
+	con->lent = NULL;
+
+	/* Resume reading on the connection waiting longest for a buffer */
+	struct ny_tcp_con *next = tcp->starved;
+	if (next) {
+		starved_unlink(next);
+		con_arm(next);
 	}
-	else {
-		if (revents & EV_READ) {
-			if (con->tcp->con_readable)
-				con->tcp->con_readable(con);
+}
+
+/**
+ * \brief Wait for socket to become writable once
+ *
+ * \param[in,out] con Connection
+ */
+static void con_want_write(struct ny_tcp_con *restrict con) {
+	con->events |= EV_WRITE;
+	con_arm(con);
+}
+
+/**
+ * \brief Link connection into flush list
+ *
+ * \param[in,out] tcp Pointer to TCP listener
+ * \param[in,out] con Connection
+ */
+static void flush_link(struct ny_tcp *restrict tcp,
+	struct ny_tcp_con *restrict con) {
+	/* Flush before the event loop blocks */
+	if (!tcp->dirty)
+		ev_prepare_start(tcp->ny->loop, &tcp->flush);
+
+	con->dirty_prev = &tcp->dirty;
+	con->dirty_next = tcp->dirty;
+	if (con->dirty_next)
+		con->dirty_next->dirty_prev = &con->dirty_next;
+	tcp->dirty = con;
+}
+
+/**
+ * \brief Unlink connection from flush list
+ *
+ * \param[in,out] con Connection
+ */
+static void flush_unlink(struct ny_tcp_con *restrict con) {
+	*con->dirty_prev = con->dirty_next;
+	if (con->dirty_next)
+		con->dirty_next->dirty_prev = con->dirty_prev;
+	con->dirty_prev = NULL;
+}
+
+/**
+ * \brief Apply socket options to connection
+ *
+ * \param[in] tcp Pointer to TCP context
+ * \param[in] fd Connection socket
+ *
+ * Options are applied on a best-effort basis.
+ */
+static void con_tune(struct ny_tcp const *restrict tcp, int fd) {
+	struct ny_tcp_opt const *opt = &tcp->opt;
+
+	int value;
+
+	if (opt->nodelay) {
+		value = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof (value));
+	}
+
+	if (opt->sndbuf)
+		setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &opt->sndbuf,
+			sizeof (opt->sndbuf));
+
+	if (opt->rcvbuf)
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &opt->rcvbuf,
+			sizeof (opt->rcvbuf));
+
+#if NY_TCP_NOTSENT_LOWAT
+	if (opt->notsent_lowat)
+		setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &opt->notsent_lowat,
+			sizeof (opt->notsent_lowat));
+#endif
+
+	if (opt->keepalive) {
+		value = 1;
+		setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &value, sizeof (value));
+
+#if NY_TCP_KEEPALIVE
+		setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &opt->keepalive,
+			sizeof (opt->keepalive));
+
+		if (opt->keepintvl)
+			setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &opt->keepintvl,
+				sizeof (opt->keepintvl));
+
+		if (opt->keepcnt)
+			setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &opt->keepcnt,
+				sizeof (opt->keepcnt));
+#endif
+	}
+
+#if NY_TCP_USER_TIMEOUT
+	if (opt->user_timeout)
+		setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &opt->user_timeout,
+			sizeof (opt->user_timeout));
+#endif
+}
+
+/**
+ * \brief Release output queue segment
+ *
+ * \param[in,out] con Connection
+ * \param[in,out] seg Segment
+ */
+static void seg_release(struct ny_tcp_con *restrict con,
+	struct ny_tcp_seg *restrict seg) {
+	/* Hand referenced payload back */
+	if (seg->release)
+		seg->release(seg->arg);
+
+	ny_alloc_release(&con->tcp->alloc_seg, seg);
+}
+
+/**
+ * \brief Append segment to output queue
+ *
+ * \param[in,out] con Connection
+ * \param[in,out] seg Segment
+ */
+static void con_append(struct ny_tcp_con *restrict con,
+	struct ny_tcp_seg *restrict seg) {
+	seg->next = NULL;
+
+	if (con->last)
+		con->last->next = seg;
+	else
+		con->out = seg;
+	con->last = seg;
+}
+
+/**
+ * \brief Remove sent octets from output queue
+ *
+ * \param[in,out] con Connection
+ * \param[in] length Number of octets to remove from output queue
+ * \param[in] copied Octets were sent by copying
+ *
+ * Segments sent without copying are kept until the kernel is done with them.
+ * This includes referenced segments sent by copying while earlier zero-copy
+ * sends, possibly of parts of the same segment, are outstanding.
+ */
+static void con_consume(struct ny_tcp_con *restrict con, size_t length,
+	bool copied) {
+	assert(length <= con->queued);
+
+	con->queued -= length;
+
+	while (length) {
+		struct ny_tcp_seg *seg = con->out;
+		size_t avail = seg->end - seg->start;
+
+		/* Segment partially sent */
+		if (length < avail) {
+			seg->start += length;
+			break;
 		}
 
-		if (revents & EV_WRITE) {
-			if (con->tcp->con_writable)
-				con->tcp->con_writable(con);
+		length -= avail;
+		con->out = seg->next;
+
+		if (seg->release && seg->base &&
+			(!copied || con->zerocopy_done != con->zerocopy_seq)) {
+			/* Wait for completion of the last zero-copy send */
+			if (copied)
+				seg->seq = con->zerocopy_seq - 1;
+
+			seg->next = NULL;
+			if (con->inflight_last)
+				con->inflight_last->next = seg;
+			else
+				con->inflight = seg;
+			con->inflight_last = seg;
 		}
+		else
+			seg_release(con, seg);
 	}
+
+	if (!con->out)
+		con->last = NULL;
 }
 
-static void timeout_event(EV_P_ struct ev_timer *timer, int revents) {
-	struct ny_tcp_con *con = (struct ny_tcp_con *) timer->data;
+/**
+ * \brief Discard output queue
+ *
+ * \param[in,out] con Connection
+ */
+static void con_discard(struct ny_tcp_con *restrict con) {
+	for (struct ny_tcp_seg *seg = con->out, *next; seg; seg = next) {
+		next = seg->next;
+		seg_release(con, seg);
+	}
 
-	if (unlikely(revents & EV_ERROR)) {
-		struct ny_error error;
-		ny_error_set(&error, NY_ERROR_DOMAIN_NY, NY_ERROR_EVWATCH);
-		con->tcp->con_error(con, &error);
+	for (struct ny_tcp_seg *seg = con->inflight, *next; seg; seg = next) {
+		next = seg->next;
+		seg_release(con, seg);
 	}
-	else if (likely(revents & EV_TIMEOUT)) {
-		/* Raise timeout event */
-		if (con->tcp->con_timeout) {
-			if (unlikely(con->tcp->con_timeout(con))) {
-				ny_tcp_con_touch(con);
-				return;
+
+	con->out = NULL;
+	con->last = NULL;
+	con->queued = 0;
+	con->inflight = NULL;
+	con->inflight_last = NULL;
+}
+
+#if NY_TCP_ZEROCOPY
+/**
+ * \brief Process zero-copy completion notifications
+ *
+ * \param[in,out] con Connection
+ *
+ * Notifications are expected in order, as TCP produces them.
+ */
+static void con_complete(struct ny_tcp_con *restrict con) {
+	while (con->zerocopy_done != con->zerocopy_seq) {
+		union {
+			struct cmsghdr align;
+			uint8_t buffer[CMSG_SPACE(sizeof (struct sock_extended_err) +
+				sizeof (struct sockaddr_in6))];
+		} control;
+
+		struct msghdr msg = {
+			.msg_control = control.buffer,
+			.msg_controllen = sizeof control.buffer
+		};
+
+		/* Read error queue */
+		if (recvmsg(con->io.fd, &msg, MSG_ERRQUEUE) < 0)
+			break;
+
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+			cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (!(cmsg->cmsg_level == IPPROTO_IP &&
+				cmsg->cmsg_type == IP_RECVERR) &&
+				!(cmsg->cmsg_level == IPPROTO_IPV6 &&
+				cmsg->cmsg_type == IPV6_RECVERR))
+				continue;
+
+			struct sock_extended_err const *serr =
+				(struct sock_extended_err const *) CMSG_DATA(cmsg);
+			if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno)
+				continue;
+
+			/* Release payload of all sends up to the last one completed */
+			uint32_t hi = serr->ee_data;
+			con->zerocopy_done = hi + 1;
+
+			struct ny_tcp_seg *seg;
+			while ((seg = con->inflight) && (int32_t) (seg->seq - hi) <= 0) {
+				con->inflight = seg->next;
+				seg_release(con, seg);
 			}
-		}
 
-		ny_tcp_con_destroy(con);
+			if (!con->inflight)
+				con->inflight_last = NULL;
+		}
 	}
 }
+#endif
 
-static void listen_event(EV_P_ struct ev_io *io, int revents) {
-	struct ny_tcp *tcp = (struct ny_tcp *) io->data;
+/**
+ * \brief Write output queue
+ *
+ * \param[in,out] con Connection
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * Write interest is armed if the socket does not take all queued output and
+ * disarmed once the output queue is empty. On error, the output queue is
+ * discarded and the connection error handler is raised, which may destroy the
+ * connection.
+ */
+static int con_flush(struct ny_tcp_con *restrict con) {
+	struct ny_tcp *tcp = con->tcp;
 
-	if (unlikely(revents & EV_ERROR)) {
-		struct ny_error error;
-		ny_error_set(&error, NY_ERROR_DOMAIN_NY, NY_ERROR_EVWATCH);
-		tcp->tcp_error(tcp, &error);
-	}
+	int ret = 0;
 
-	else if (likely(revents & EV_READ)) {
-		for (unsigned iter = 0; iter < NY_TCP_ACCEPT_MAX; ++iter) {
-			struct sockaddr_in6 address;
-			socklen_t addrlen = sizeof address;
-
-			/* Accept connection */
-			int fd = accept_safe(tcp, (struct sockaddr *) &address, &addrlen);
-
-			/* Handle errors */
-			if (unlikely(fd < 0)) {
-				if (unlikely(errno != EAGAIN || errno != EWOULDBLOCK)) {
-					if (tcp->tcp_error) {
-						struct ny_error error;
-						ny_error_set(&error, NY_ERROR_DOMAIN_ERRNO, errno);
-						tcp->tcp_error(tcp, &error);
-					}
-				}
+	while (con->out) {
+		struct ny_tcp_seg *seg = con->out;
 
-				break;
-			}
+		/* Send file contents in chunks */
+		if (!seg->base) {
+			size_t length = seg->end - seg->start;
+			if (length > NY_TCP_SENDFILE_CHUNK)
+				length = NY_TCP_SENDFILE_CHUNK;
 
-			/* Assume that all addresses are IPv6 */
-			assert(address.sin6_family == AF_INET6);
+			ssize_t wlen = ny_io_sendfile(con->io.fd, seg->fd, length,
+				seg->offset + seg->start);
+			if (unlikely(wlen <= 0)) {
+				/* File shorter than queued */
+				if (!wlen)
+					ret = EIO;
 
-			/* Raise conect event */
-			if (tcp->tcp_connect) {
-				if (unlikely(!tcp->tcp_connect(tcp, &address))) {
-					/* Reject connection */
-					ny_io_close(fd);
+				else if (errno == EINTR)
 					continue;
-				}
+
+				else if (unlikely(errno != EAGAIN && errno != EWOULDBLOCK))
+					ret = errno;
+
+				break;
 			}
 
-			/* Allocate memory for connection structure */
-			struct ny_tcp_con *con = ny_alloc_acquire(&tcp->alloc_con);
-			if (unlikely(!con)) {
-				if (tcp->tcp_error)
-					tcp->tcp_error(tcp, &tcp->ny->error);
+			/* Reset timeout */
+			ny_tcp_con_touch(con);
 
-				/* Close connection */
-				ny_io_close(fd);
+			bool done = (size_t) wlen == seg->end - seg->start;
+			con_consume(con, wlen, true);
+
+			/* Yield to other connections before sending the next chunk */
+			if (!done)
 				break;
+
+			continue;
+		}
+
+		struct iovec vector[NY_TCP_IOV_MAX];
+		size_t count = 0;
+		size_t length = 0;
+
+		/* Referenced payload is copied once zero-copy has been turned off */
+		bool zerocopy = con->out->release && con->zerocopy > 0;
+
+		/* Gather segments sent the same way */
+		for (; seg && seg->base && count < NY_TCP_IOV_MAX &&
+			(seg->release && con->zerocopy > 0) == zerocopy;
+			seg = seg->next, ++count) {
+			vector[count].iov_base = (void *) (seg->base + seg->start);
+			vector[count].iov_len = seg->end - seg->start;
+			length += vector[count].iov_len;
+		}
+
+		ssize_t wlen;
+#if NY_TCP_ZEROCOPY
+		if (zerocopy) {
+			struct msghdr msg = {
+				.msg_iov = vector,
+				.msg_iovlen = count
+			};
+
+			wlen = sendmsg(con->io.fd, &msg, MSG_ZEROCOPY);
+
+			/* Option memory exhausted, send the same run copying instead */
+			if (unlikely(wlen < 0 && errno == ENOBUFS)) {
+				con->zerocopy = -1;
+				zerocopy = false;
+				wlen = ny_io_writev(con->io.fd, vector, count);
 			}
+		}
+		else
+#endif
+			wlen = ny_io_writev(con->io.fd, vector, count);
 
-			/* Initialise user-data pointer */
-			con->data = NULL;
+		if (unlikely(wlen < 0)) {
+			if (errno == EINTR)
+				continue;
 
-			/* Set TCP context pointer */
-			con->tcp = tcp;
+			if (unlikely(errno != EAGAIN && errno != EWOULDBLOCK))
+				ret = errno;
+
+			break;
+		}
 
-			/* Initialise timeout watcher */
-			ev_timer_init(&con->timer, timeout_event,
-				NY_TCP_TIMEOUT, NY_TCP_TIMEOUT);
-			ev_set_priority(&con->timer, NY_TCP_TIMER_PRIO);
-			con->timer.data = con;
-			ev_timer_start(EV_A_ &con->timer);
+		/* Reset timeout */
+		ny_tcp_con_touch(con);
 
-			/* Initialise I/O watcher */
-			ev_io_init(&con->io, con_event, fd, EV_READ);
-			ev_set_priority(&con->io, NY_TCP_ACCEPT_PRIO);
-			con->io.data = con;
-			ev_io_start(EV_A_ &con->io);
+		if (zerocopy) {
+			/* Tag payload with the number of this send */
+			size_t covered = 0;
+			for (struct ny_tcp_seg *seg = con->out; seg && covered < (size_t) wlen;
+				seg = seg->next) {
+				seg->seq = con->zerocopy_seq;
+				covered += seg->end - seg->start;
+			}
 
-			/* Emit connect event */
-			if (tcp->con_connect)
-				tcp->con_connect(con);
+			++con->zerocopy_seq;
 		}
+
+		con_consume(con, wlen, !zerocopy);
+
+		/* Socket buffer full */
+		if ((size_t) wlen < length)
+			break;
 	}
-}
 
-int ny_tcp_init(struct ny_tcp *restrict tcp, struct ny *restrict ny,
-	char const *restrict node, char const *restrict service,
-	uint_least32_t maxcon) {
-	assert(tcp);
-	assert(ny);
+	/* Output can not be delivered any more */
+	if (unlikely(ret))
+		con_discard(con);
 
-	int _;
-	int ret = -1;
+	bool blocked = con->out;
+	if (blocked != con->blocked) {
+		con->blocked = blocked;
+		con_arm(con);
+	}
 
-	/* Initialise structure */
-	tcp->data = NULL;
-	tcp->ny = ny;
-	tcp->tcp_error = NULL;
-	tcp->tcp_connect = NULL;
-	tcp->con_error = NULL;
-	tcp->con_destroy = NULL;
-	tcp->con_connect = NULL;
-	tcp->con_readable = NULL;
-	tcp->con_writable = NULL;
-	tcp->con_timeout = NULL;
+	if (unlikely(ret)) {
+		struct ny_error error;
+		ny_error_set(&error, NY_ERROR_DOMAIN_ERRNO, ret);
 
-	struct addrinfo *res;
+		if (tcp->con_error)
+			tcp->con_error(con, &error);
+		else
+			ny_tcp_con_destroy(con);
 
-	_ = getaddrinfo(node, service, &hints, &res);
-	if (unlikely(_)) {
-		ny_error_set(&ny->error, NY_ERROR_DOMAIN_GAI, _);
-		goto exit;
+		ret = -1;
 	}
 
-	int fd = -1;
-	for (struct addrinfo *rp = res; rp; rp = rp->ai_next) {
-		/* Create socket */
-		fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-		if (unlikely(fd < 0)) {
-			ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
-			continue;
-		}
+	return ret;
+}
 
-		/* Allow address reuse */
-		int value = 1;
-		if (unlikely(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &value,
-			sizeof (value)))) {
-			ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
-			ny_io_close(fd);
-			continue;
-		}
+/**
+ * \brief Complete outbound connection
+ *
+ * \param[in,out] con Connection
+ *
+ * \return Zero on success or non-zero on error
+ *
+ * On error, the connection error handler is raised, which may destroy the
+ * connection.
+ */
+static int con_established(struct ny_tcp_con *restrict con) {
+	struct ny_tcp *tcp = con->tcp;
 
-		/* Bind to socket */
-		if (likely(!bind(fd, rp->ai_addr, rp->ai_addrlen)))
-			break;
+	int ret = -1;
 
-		ny_error_set(&ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
-		ny_io_close(fd);
+	int value;
+	socklen_t length = sizeof value;
+	if (unlikely(getsockopt(con->io.fd, SOL_SOCKET, SO_ERROR, &value,
+		&length)))
+		value = errno;
+
+	/* Still connecting */
+	if (unlikely(value == EINPROGRESS || value == EALREADY)) {
+		ret = 0;
+		goto exit;
 	}
 
-	if (fd < 0)
+	if (unlikely(value)) {
+		struct ny_error error;
+		ny_error_set(&error, NY_ERROR_DOMAIN_ERRNO, value);
+
+		if (tcp->con_error)
+			tcp->con_error(con, &error);
+		else
+			ny_tcp_con_destroy(con);
+
 		goto exit;
+	}
 
-	/* Mark socket as non-blocking */
-	ny_io_fl_set(fd, O_NONBLOCK);
+	con->connecting = false;
+	ny_tcp_con_touch(con);
 
-	/* Close socket on exec */
-	ny_io_fd_set(fd, FD_CLOEXEC);
+	/* Emit connect event */
+	if (tcp->con_connect)
+		tcp->con_connect(con);
 
-	/* Initialise I/O watcher */
-	ev_io_init(&tcp->io, listen_event, fd, EV_READ);
-	ev_set_priority(&tcp->io, NY_TCP_IO_PRIO);
-	tcp->io.data = tcp;
+	ret = 0;
 
-	/* Initialise allocator */
-	_ = ny_alloc_init(&tcp->alloc_con, ny, maxcon, sizeof (struct ny_tcp_con));
-	if (unlikely(_))
-		goto exit;
+exit:
+	return ret;
+}
+
+/**
+ * \brief Check idle connection
+ *
+ * \param[in] con Connection
+ *
+ * \return Whether the connection is neither closed nor holds stray data
+ */
+static bool con_alive(struct ny_tcp_con const *restrict con) {
+	uint8_t octet;
+	ssize_t rlen = recv(con->io.fd, &octet, sizeof octet, MSG_PEEK);
+
+	return rlen < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+/**
+ * \brief Link connection into idle list of its upstream pool
+ *
+ * \param[in,out] con Connection
+ */
+static void idle_link(struct ny_tcp_con *restrict con) {
+	struct ny_tcp_upstream *upstream = con->upstream;
+
+	con->idle_prev = &upstream->idle;
+	con->idle_next = upstream->idle;
+	if (con->idle_next)
+		con->idle_next->idle_prev = &con->idle_next;
+	upstream->idle = con;
+	++upstream->nidle;
+}
+
+/**
+ * \brief Unlink connection from idle list of its upstream pool
+ *
+ * \param[in,out] con Connection
+ */
+static void idle_unlink(struct ny_tcp_con *restrict con) {
+	*con->idle_prev = con->idle_next;
+	if (con->idle_next)
+		con->idle_next->idle_prev = con->idle_prev;
+	con->idle_prev = NULL;
+	--con->upstream->nidle;
+}
+
+#if NY_TCP_SPLICE
+/**
+ * \brief Acquire relay pipe
+ *
+ * \param[in,out] tcp Pointer to TCP context
+ * \param[out] fds Pipe file descriptors
+ *
+ * \return Zero on success or non-zero on error
+ */
+static int pipe_acquire(struct ny_tcp *restrict tcp, int fds[2]) {
+	int ret = -1;
+
+	/* Reuse idle pipe */
+	if (tcp->npipe) {
+		--tcp->npipe;
+		fds[0] = tcp->pipes[tcp->npipe][0];
+		fds[1] = tcp->pipes[tcp->npipe][1];
+		ret = 0;
+		goto exit;
+	}
+
+	if (unlikely(pipe(fds))) {
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+		goto exit;
+	}
+
+	for (unsigned iter = 0; iter < 2; ++iter) {
+		ny_io_fd_set(fds[iter], FD_CLOEXEC);
+		ny_io_fl_set(fds[iter], O_NONBLOCK);
+	}
+
+	ret = 0;
+
+exit:
+	return ret;
+}
+#endif
+
+/**
+ * \brief Release relay pipe
+ *
+ * \param[in,out] tcp Pointer to TCP context
+ * \param[in] fds Pipe file descriptors
+ * \param[in] empty Whether the pipe is empty
+ */
+static void pipe_release(struct ny_tcp *restrict tcp, int const fds[2],
+	bool empty) {
+	/* Keep empty pipe for reuse */
+	if (empty && tcp->npipe < NY_TCP_PIPE_MAX) {
+		tcp->pipes[tcp->npipe][0] = fds[0];
+		tcp->pipes[tcp->npipe][1] = fds[1];
+		++tcp->npipe;
+	}
+	else {
+		ny_io_close(fds[0]);
+		ny_io_close(fds[1]);
+	}
+}
+
+/**
+ * \brief Detach and free relay
+ *
+ * \param[in,out] relay Relay
+ */
+static void relay_free(struct ny_tcp_relay *restrict relay) {
+	struct ny_tcp_con *src = relay->src;
+	struct ny_tcp_con *dst = relay->dst;
+
+	pipe_release(src->tcp, relay->pipe, !relay->pending);
+
+	src->relay = NULL;
+	if (dst)
+		dst->relay_in = NULL;
+
+	ny_alloc_release(&src->tcp->alloc_relay, relay);
+}
+
+/**
+ * \brief End relay
+ *
+ * \param[in,out] relay Relay
+ * \param[in] code Error number or zero at end of stream
+ *
+ * Raises the relay end handler of the source connection, which may destroy
+ * either connection.
+ */
+static void relay_end(struct ny_tcp_relay *restrict relay, int code) {
+	struct ny_tcp_con *src = relay->src;
+	struct ny_tcp_con *dst = relay->dst;
+
+	relay_free(relay);
+
+	/* Restore requested events */
+	con_arm(src);
+	if (dst)
+		con_arm(dst);
+
+	if (src->tcp->con_relayed) {
+		struct ny_error error;
+		if (code)
+			ny_error_set(&error, NY_ERROR_DOMAIN_ERRNO, code);
+
+		src->tcp->con_relayed(src, code ? &error : NULL);
+	}
+}
+
+#if NY_TCP_SPLICE
+/**
+ * \brief Move data through relay
+ *
+ * \param[in,out] relay Relay
+ *
+ * Data is moved until either side would block. The relay may end, raising the
+ * relay end handler.
+ */
+static void relay_pump(struct ny_tcp_relay *restrict relay) {
+	struct ny_tcp_con *src = relay->src;
+	struct ny_tcp_con *dst = relay->dst;
+
+	bool wait = false;
+	size_t moved = 0;
+
+	for (;;) {
+		if (relay->pending) {
+			/* Send output queued on destination first */
+			if (dst && dst->out) {
+				wait = true;
+				break;
+			}
+
+			ssize_t wlen = splice(relay->pipe[0], NULL,
+				dst ? dst->io.fd : relay->fd, dst ? NULL : &relay->offset,
+				relay->pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+			if (unlikely(wlen < 0)) {
+				if (errno == EINTR)
+					continue;
+
+				if (likely(errno == EAGAIN || errno == EWOULDBLOCK)) {
+					wait = true;
+					break;
+				}
+
+				relay_end(relay, errno);
+				return;
+			}
+
+			relay->pending -= wlen;
+			if (dst)
+				ny_tcp_con_touch(dst);
+
+			continue;
+		}
+
+		if (relay->eof) {
+			relay_end(relay, 0);
+			return;
+		}
+
+		/* Yield to other connections, the source stays readable */
+		if (moved >= NY_TCP_SPLICE_CHUNK)
+			break;
+
+		ssize_t rlen = splice(src->io.fd, NULL, relay->pipe[1], NULL,
+			NY_TCP_SPLICE_MAX, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (unlikely(rlen < 0)) {
+			if (errno == EINTR)
+				continue;
+
+			if (likely(errno == EAGAIN || errno == EWOULDBLOCK))
+				break;
+
+			relay_end(relay, errno);
+			return;
+		}
+
+		if (rlen == 0)
+			relay->eof = true;
+
+		relay->pending += rlen;
+		moved += rlen;
+		ny_tcp_con_touch(src);
+	}
+
+	/* Apply back-pressure */
+	relay->wait = wait;
+	con_arm(src);
+	if (dst)
+		con_arm(dst);
+}
+#endif
+
+static void trim_event(EV_P_ struct ev_timer *timer, int revents) {
+	(void) revents;
+
+	struct ny_tcp *tcp = (struct ny_tcp *) timer->data;
+
+	/* Hand memory unused since the last load peak back to the system */
+	ny_alloc_trim(&tcp->alloc_con);
+	ny_alloc_trim(&tcp->alloc_seg);
+	ny_alloc_trim(&tcp->alloc_buf);
+}
+
+static void flush_event(EV_P_ struct ev_prepare *prepare, int revents) {
+	(void) revents;
+
+	struct ny_tcp *tcp = (struct ny_tcp *) prepare->data;
+
+	/* Write output queued during this event loop iteration */
+	struct ny_tcp_con *con;
+	while ((con = tcp->dirty)) {
+		flush_unlink(con);
+		con_flush(con);
+	}
+
+	ev_prepare_stop(EV_A_ prepare);
+}
+
+static void con_event(EV_P_ struct ev_io *io, int revents) {
+	struct ny_tcp_con *con = (struct ny_tcp_con *) io->data;
+
+	if (unlikely(revents & EV_ERROR)) {
+		struct ny_error error;
+		ny_error_set(&error, NY_ERROR_DOMAIN_NY, NY_ERROR_EVWATCH);
+		con->tcp->con_error(con, &error);
+	}
+	else if (unlikely(con->idle_prev)) {
+#if NY_TCP_ZEROCOPY
+		if (con->zerocopy_done != con->zerocopy_seq)
+			con_complete(con);
+#endif
+
+		/* Idle connection closed by peer or out of sync */
+		if (!con_alive(con))
+			ny_tcp_con_destroy(con);
+	}
+	else if (unlikely(con->connecting)) {
+		/* Handle output and other events in the next iteration */
+		con_established(con);
+	}
+	else {
+#if NY_TCP_ZEROCOPY
+		/* Completion notifications raise error events */
+		if (con->zerocopy_done != con->zerocopy_seq)
+			con_complete(con);
+#endif
+
+		if (revents & EV_WRITE) {
+			if (con->blocked) {
+				/* Continue writing queued output */
+				if (unlikely(con_flush(con)))
+					return;
+
+				/* Only report writability once the output queue is empty */
+				if (con->blocked)
+					revents &= ~EV_WRITE;
+			}
+
+#if NY_TCP_SPLICE
+			/* Continue relaying into this connection */
+			if (con->relay_in && con->relay_in->wait && !con->blocked) {
+				relay_pump(con->relay_in);
+				return;
+			}
+#endif
+		}
+
+#if NY_TCP_SPLICE
+		/* Relay data arriving on this connection */
+		if ((revents & EV_READ) && con->relay) {
+			relay_pump(con->relay);
+			return;
+		}
+#endif
+
+		if (revents & EV_WRITE) {
+			if (!(con->events & EV_WRITE))
+				revents &= ~EV_WRITE;
+
+			/* Write interest is one-shot in edge-triggered mode */
+			else if (con->tcp->edge && !con->blocked) {
+				con->events &= ~EV_WRITE;
+				con_arm(con);
+			}
+		}
+
+		if (revents & EV_READ) {
+			if (con->tcp->con_readable)
+				con->tcp->con_readable(con);
+		}
+
+		if (revents & EV_WRITE) {
+			if (con->tcp->con_writable)
+				con->tcp->con_writable(con);
+		}
+	}
+}
+
+/**
+ * \brief Connection timeout in wheel ticks
+ *
+ * \return Number of ticks
+ *
+ * One tick is added as the current tick is partially over already by the time
+ * a connection is touched.
+ */
+static ny_const uint32_t timeout_ticks() {
+	uint32_t ticks = NY_TCP_TIMEOUT / NY_TCP_WHEEL_TICK;
+	if (ticks * NY_TCP_WHEEL_TICK < NY_TCP_TIMEOUT)
+		++ticks;
+
+	return ticks + 1;
+}
+
+/**
+ * \brief Statistics histogram bucket
+ *
+ * \param[in] value Value
+ *
+ * \return Bucket counting \p value
+ */
+static ny_const unsigned hist_bucket(uint32_t value) {
+	unsigned bucket = 0;
+
+	while (value && bucket < NY_TCP_HIST_SIZE - 1) {
+		value >>= 1;
+		++bucket;
+	}
+
+	return bucket;
+}
+
+/**
+ * \brief Link connection into timing wheel
+ *
+ * \param[in,out] tcp Pointer to TCP listener
+ * \param[in,out] con Connection
+ * \param[in] expire Tick at which to check the connection for expiry
+ */
+static void wheel_link(struct ny_tcp *restrict tcp,
+	struct ny_tcp_con *restrict con, uint32_t expire) {
+	struct ny_tcp_con **bucket = tcp->wheel + expire % NY_TCP_WHEEL_SIZE;
+
+	con->prev = bucket;
+	con->next = *bucket;
+	if (con->next)
+		con->next->prev = &con->next;
+	*bucket = con;
+}
+
+/**
+ * \brief Unlink connection from timing wheel
+ *
+ * \param[in,out] con Connection
+ */
+static void wheel_unlink(struct ny_tcp_con *restrict con) {
+	*con->prev = con->next;
+	if (con->next)
+		con->next->prev = con->prev;
+}
+
+static void wheel_event(EV_P_ struct ev_timer *timer, int revents) {
+	struct ny_tcp *tcp = (struct ny_tcp *) timer->data;
+
+	if (unlikely(revents & EV_ERROR)) {
+		struct ny_error error;
+		ny_error_set(&error, NY_ERROR_DOMAIN_NY, NY_ERROR_EVWATCH);
+		tcp->tcp_error(tcp, &error);
+		return;
+	}
+
+	uint32_t tick = ++tcp->tick;
+	struct ny_tcp_con **bucket = tcp->wheel + tick % NY_TCP_WHEEL_SIZE;
+
+	/* Process all connections due at this tick */
+	struct ny_tcp_con *con;
+	while ((con = *bucket)) {
+		wheel_unlink(con);
+
+		/* Connection touched since it was linked, check again later */
+		uint32_t expire = con->touched + timeout_ticks();
+		if ((int32_t) (expire - tick) > 0) {
+			wheel_link(tcp, con, expire);
+			continue;
+		}
+
+		/* Idle connections expire silently */
+		if (con->idle_prev) {
+			ny_tcp_con_destroy(con);
+			continue;
+		}
+
+		/* Keep connection linked while the handler runs */
+		con->touched = tick;
+		wheel_link(tcp, con, tick + timeout_ticks());
+
+		/* Raise timeout event */
+		if (tcp->con_timeout) {
+			if (unlikely(tcp->con_timeout(con)))
+				continue;
+		}
+
+		ny_tcp_con_destroy(con);
+	}
+}
+
+/**
+ * \brief Stop accepting connections on all listening sockets
+ *
+ * \param[in,out] tcp Pointer to TCP listener
+ */
+static void listen_stop(struct ny_tcp *restrict tcp) {
+	for (unsigned iter = 0; iter < tcp->nsock; ++iter)
+		ev_io_stop(tcp->ny->loop, &tcp->sock[iter].io);
+}
+
+/**
+ * \brief Resume accepting connections on all listening sockets
+ *
+ * \param[in,out] tcp Pointer to TCP listener
+ */
+static void listen_start(struct ny_tcp *restrict tcp) {
+	for (unsigned iter = 0; iter < tcp->nsock; ++iter) {
+		if (tcp->sock[iter].io.fd >= 0)
+			ev_io_start(tcp->ny->loop, &tcp->sock[iter].io);
+	}
+}
+
+/**
+ * \brief Initialise connection
+ *
+ * \param[in,out] tcp Pointer to TCP context
+ * \param[out] con Connection
+ * \param[in] fd Connected socket
+ */
+static void con_init(struct ny_tcp *restrict tcp,
+	struct ny_tcp_con *restrict con, int fd) {
+	/* Initialise user-data pointer */
+	con->data = NULL;
+
+	/* Set TCP context pointer */
+	con->tcp = tcp;
+
+	/* Initialise output queue */
+	con->out = NULL;
+	con->last = NULL;
+	con->queued = 0;
+	con->dirty_prev = NULL;
+	con->inflight = NULL;
+	con->inflight_last = NULL;
+	con->zerocopy_seq = 0;
+	con->zerocopy_done = 0;
+	con->zerocopy = 0;
+	con->events = EV_READ;
+	con->blocked = false;
+	con->relay = NULL;
+	con->relay_in = NULL;
+
+	/* No connection information sampled yet */
+	con->info.stamp = 0.0;
+
+	/* Not tracked in admission table */
+	con->admit = NY_ADMIT_NONE;
+
+	/* No receive buffer lent */
+	con->lent = NULL;
+	con->starved_prev = NULL;
+
+	/* Not part of an upstream pool */
+	con->connecting = false;
+	con->upstream = NULL;
+	con->idle_prev = NULL;
+
+	/* Link into timing wheel */
+	con->touched = tcp->tick;
+	wheel_link(tcp, con, tcp->tick + timeout_ticks());
+
+	/* Only tick while there are connections */
+	if (!tcp->ncon++)
+		ev_timer_again(tcp->ny->loop, &tcp->timer);
+
+	/* Initialise I/O watcher */
+	ev_io_init(&con->io, con_event, fd, EV_READ);
+	ev_set_priority(&con->io, NY_TCP_IO_PRIO);
+	con->io.data = con;
+	ev_io_start(tcp->ny->loop, &con->io);
+}
+
+/**
+ * \brief Accept pending connections
+ *
+ * \param[in,out] tcp Pointer to TCP listener
+ * \param[in] lsock Listening socket
+ * \param[in] max Maximum number of connections to accept
+ *
+ * \return Number of connections accepted or \p max if more may be pending
+ *
+ * If the connection pool runs out, the listener is paused until a connection
+ * is released, leaving further connections in the kernel backlog.
+ */
+static unsigned accept_batch(struct ny_tcp *restrict tcp, int lsock,
+	unsigned max) {
+	assert(tcp);
+
+	unsigned iter;
+	for (iter = 0; iter < max; ++iter) {
+		/* Allocate memory for connection structure */
+		struct ny_tcp_con *con = ny_alloc_acquire(&tcp->alloc_con);
+		if (unlikely(!con)) {
+			/* Pause listener until a connection is released */
+			listen_stop(tcp);
+			tcp->paused = true;
+			break;
+		}
+
+		struct sockaddr_storage address;
+		socklen_t addrlen = sizeof address;
+
+		/* Accept connection */
+		int fd = accept_safe(tcp, lsock, (struct sockaddr *) &address,
+			&addrlen);
+
+		/* Handle errors */
+		if (unlikely(fd < 0)) {
+			if (unlikely(errno != EAGAIN && errno != EWOULDBLOCK)) {
+				if (tcp->tcp_error) {
+					struct ny_error error;
+					ny_error_set(&error, NY_ERROR_DOMAIN_ERRNO, errno);
+					tcp->tcp_error(tcp, &error);
+				}
+			}
+
+			ny_alloc_release(&tcp->alloc_con, con);
+			break;
+		}
+
+		/* Reject sources exceeding their admission limits */
+		uint32_t slot = NY_ADMIT_NONE;
+		if (tcp->admit && unlikely(!ny_admit_acquire(tcp->admit,
+			(struct sockaddr const *) &address, ev_now(tcp->ny->loop), &slot))) {
+			ny_io_close(fd);
+			ny_alloc_release(&tcp->alloc_con, con);
+			continue;
+		}
+
+		/* Raise conect event */
+		if (tcp->tcp_connect) {
+			if (unlikely(!tcp->tcp_connect(tcp,
+				(struct sockaddr const *) &address, addrlen))) {
+				/* Reject connection */
+				if (tcp->admit)
+					ny_admit_release(tcp->admit, slot);
+				ny_io_close(fd);
+				ny_alloc_release(&tcp->alloc_con, con);
+				continue;
+			}
+		}
+
+		/* Apply socket options */
+		if (address.ss_family != AF_UNIX)
+			con_tune(tcp, fd);
+
+		con_init(tcp, con, fd);
+		con->admit = slot;
+
+		/* Emit connect event */
+		if (tcp->con_connect)
+			tcp->con_connect(con);
+	}
+
+	return iter;
+}
+
+static void listen_event(EV_P_ struct ev_io *io, int revents) {
+	struct ny_tcp *tcp = (struct ny_tcp *) io->data;
+
+	if (unlikely(revents & EV_ERROR)) {
+		struct ny_error error;
+		ny_error_set(&error, NY_ERROR_DOMAIN_NY, NY_ERROR_EVWATCH);
+		tcp->tcp_error(tcp, &error);
+	}
+
+	else if (likely(revents & EV_READ)) {
+		unsigned count = accept_batch(tcp, io->fd, tcp->accept_max);
+
+		/* Time spent in this loop iteration so far */
+		ev_tstamp lag = ev_time() - ev_now(EV_A);
+
+		/* Adapt batch size to backlog and loop lag */
+		if (unlikely(lag >= NY_TCP_ACCEPT_LAG)) {
+			if (tcp->accept_max > NY_TCP_ACCEPT_MIN)
+				tcp->accept_max /= 2;
+		}
+		else if (count == tcp->accept_max) {
+			if (tcp->accept_max < NY_TCP_ACCEPT_LIMIT)
+				tcp->accept_max *= 2;
+		}
+	}
+}
+
+/**
+ * \brief Number of listening sockets with network addresses
+ *
+ * \param[in] tcp Pointer to TCP listener
+ *
+ * \return Number of sockets
+ */
+static unsigned sock_inet(struct ny_tcp const *restrict tcp) {
+	unsigned count = 0;
+	for (unsigned iter = 0; iter < tcp->nsock; ++iter)
+		count += tcp->sock[iter].address.ss_family != AF_UNIX;
+
+	return count;
+}
+
+/**
+ * \brief Whether listening socket is shared between workers
+ *
+ * \param[in] tcp Pointer to TCP listener
+ * \param[in] sock Listening socket
+ *
+ * \return Whether the socket is shared
+ */
+static bool sock_shared(struct ny_tcp const *restrict tcp,
+	struct ny_tcp_sock const *restrict sock) {
+	/* Path names can only be bound once */
+	return !tcp->reuseport || sock->address.ss_family == AF_UNIX;
+}
+
+/**
+ * \brief Check for stale UNIX domain socket file
+ *
+ * \param[in] address Socket address
+ * \param[in] addrlen Address length
+ *
+ * \return Whether nobody listens on the socket
+ */
+static bool sock_stale(struct sockaddr const *restrict address,
+	socklen_t addrlen) {
+	bool ret = false;
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (unlikely(fd < 0))
+		goto exit;
+
+	/* Do not wait for a full backlog */
+	ny_io_fl_set(fd, O_NONBLOCK);
+
+	ret = connect(fd, address, addrlen) && errno == ECONNREFUSED;
+	ny_io_close(fd);
+
+exit:
+	return ret;
+}
+
+/**
+ * \brief Create bound socket
+ *
+ * \param[in,out] tcp Pointer to TCP listener
+ * \param[in] address Local address
+ * \param[in] addrlen Address length
+ *
+ * \return Non-negative file descriptor or a negative integer on failure
+ */
+static int sock_bind(struct ny_tcp *restrict tcp,
+	struct sockaddr const *restrict address, socklen_t addrlen) {
+	assert(tcp);
+	assert(address);
+
+	bool local = address->sa_family == AF_UNIX;
+
+	/* Create socket */
+	int fd = socket(address->sa_family, SOCK_STREAM, local ? 0 : IPPROTO_TCP);
+	if (unlikely(fd < 0)) {
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+		goto exit;
+	}
+
+	/* Allow address reuse */
+	int value = 1;
+	if (unlikely(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &value,
+		sizeof (value))))
+		goto error;
+
+	/* Leave IPv4 addresses to separately bound sockets */
+	if (sock_inet(tcp) > 1 && address->sa_family == AF_INET6 &&
+		!IN6_IS_ADDR_V4MAPPED(
+			&((struct sockaddr_in6 const *) address)->sin6_addr)) {
+		if (unlikely(setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &value,
+			sizeof (value))))
+			goto error;
+	}
+
+	/* Allow several workers to bind the same address */
+	if (tcp->reuseport && !local) {
+#if NY_TCP_REUSEPORT
+		if (unlikely(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &value,
+			sizeof (value))))
+			goto error;
+#else
+		errno = ENOPROTOOPT;
+		goto error;
+#endif
+	}
+
+	/* Bind to socket */
+	if (unlikely(bind(fd, address, addrlen))) {
+		if (!local || errno != EADDRINUSE || !sock_stale(address, addrlen))
+			goto error;
+
+		/* Replace stale socket file */
+		if (unlink(((struct sockaddr_un const *) address)->sun_path) ||
+			bind(fd, address, addrlen))
+			goto error;
+	}
+
+	/* Close socket on exec */
+	ny_io_fd_set(fd, FD_CLOEXEC);
+
+	goto exit;
+
+error:
+	ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+	ny_io_close(fd);
+	fd = -1;
+
+exit:
+	return fd;
+}
+
+/**
+ * \brief Listen on bound socket and start I/O watcher
+ *
+ * \param[in,out] tcp Pointer to TCP listener
+ * \param[in,out] sock Listening socket
+ * \param[in] fd Bound socket
+ *
+ * \return Zero on success or non-zero on error
+ */
+static int sock_listen(struct ny_tcp *restrict tcp,
+	struct ny_tcp_sock *restrict sock, int fd) {
+	assert(tcp);
+	assert(fd >= 0);
+
+	int ret = -1;
+
+	bool local = sock->address.ss_family == AF_UNIX;
+
+	/* Only wake up for connections with data */
+	if (tcp->defer_accept && !local) {
+#if NY_TCP_DEFER_ACCEPT
+		if (unlikely(setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+			&tcp->defer_accept, sizeof (tcp->defer_accept))))
+			goto error;
+#else
+		errno = ENOPROTOOPT;
+		goto error;
+#endif
+	}
+
+	/* Accept data in SYN */
+	if (tcp->fastopen && !local) {
+#if NY_TCP_FASTOPEN
+		if (unlikely(setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN,
+			&tcp->fastopen, sizeof (tcp->fastopen))))
+			goto error;
+#else
+		errno = ENOPROTOOPT;
+		goto error;
+#endif
+	}
+
+	/* Listen on socket */
+	if (unlikely(listen(fd, SOMAXCONN)))
+		goto error;
+
+	/* Mark socket as non-blocking */
+	ny_io_fl_set(fd, O_NONBLOCK);
+
+	ev_io_set(&sock->io, fd, EV_READ);
+	ev_io_start(tcp->ny->loop, &sock->io);
+
+	ret = 0;
+	goto exit;
+
+error:
+	ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+
+exit:
+	return ret;
+}
+
+/**
+ * \brief Inherit or create bound socket
+ *
+ * \param[in,out] tcp Pointer to TCP listener
+ * \param[in] address Local address
+ * \param[in] addrlen Address length
+ *
+ * \return Non-negative file descriptor or a negative integer on failure
+ */
+static int sock_open(struct ny_tcp *restrict tcp,
+	struct sockaddr const *restrict address, socklen_t addrlen) {
+	/* Prefer socket inherited on binary upgrade */
+	int fd = ny_inherit(address, addrlen);
+	if (fd < 0)
+		fd = sock_bind(tcp, address, addrlen);
+
+	return fd;
+}
+
+/**
+ * \brief Initialise listening socket
+ *
+ * \param[in,out] tcp Pointer to TCP listener
+ * \param[out] sock Listening socket
+ */
+static void sock_init(struct ny_tcp *restrict tcp,
+	struct ny_tcp_sock *restrict sock) {
+	ev_io_init(&sock->io, listen_event, -1, EV_READ);
+	ev_set_priority(&sock->io, NY_TCP_ACCEPT_PRIO);
+	sock->io.data = tcp;
+}
+
+/**
+ * \brief Close listening socket
+ *
+ * \param[in,out] tcp Pointer to TCP listener
+ * \param[in,out] sock Listening socket
+ */
+static void sock_close(struct ny_tcp *restrict tcp,
+	struct ny_tcp_sock *restrict sock) {
+	if (sock->io.fd >= 0) {
+		ev_io_stop(tcp->ny->loop, &sock->io);
+
+		int _ = ny_io_close(sock->io.fd);
+		assert(!_);
+
+		ev_io_set(&sock->io, -1, EV_READ);
+	}
+}
+
+/**
+ * \brief Recreate memory pools after fork
+ *
+ * \param[in,out] tcp Pointer to TCP context
+ *
+ * \return Zero on success or non-zero on error
+ */
+static int pool_renew(struct ny_tcp *restrict tcp) {
+	int _;
+	int ret = -1;
+
+	/* Connections would be left pointing into the discarded pools */
+	if (unlikely(tcp->ncon || tcp->dirty)) {
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, EBUSY);
+		goto exit;
+	}
+
+	/*
+	 * Recreate the pools so that their pages are private to this worker and
+	 * first touched on its NUMA node. The old pools are only replaced once
+	 * all new ones exist, so that they stay valid on error.
+	 */
+	struct ny_alloc alloc_con, alloc_seg, alloc_relay, alloc_buf;
+
+	_ = ny_alloc_init_grow(&alloc_con, tcp->ny, tcp->maxcon,
+		sizeof (struct ny_tcp_con));
+	if (unlikely(_))
+		goto exit;
+
+	_ = ny_alloc_init_grow(&alloc_seg, tcp->ny, seg_number(tcp->maxcon),
+		NY_TCP_SEG_SIZE);
+	if (unlikely(_))
+		goto con;
+
+	_ = ny_alloc_init(&alloc_relay, tcp->ny, tcp->maxcon,
+		sizeof (struct ny_tcp_relay));
+	if (unlikely(_))
+		goto seg;
+
+	_ = ny_alloc_init_grow(&alloc_buf, tcp->ny, buf_number(tcp->maxcon),
+		NY_TCP_BUF_SIZE);
+	if (unlikely(_))
+		goto relay;
+
+	ny_alloc_destroy(&tcp->alloc_con);
+	tcp->alloc_con = alloc_con;
+	ny_alloc_destroy(&tcp->alloc_seg);
+	tcp->alloc_seg = alloc_seg;
+	ny_alloc_destroy(&tcp->alloc_relay);
+	tcp->alloc_relay = alloc_relay;
+	ny_alloc_destroy(&tcp->alloc_buf);
+	tcp->alloc_buf = alloc_buf;
+
+	/* Do not share relay pipes with the parent */
+	while (tcp->npipe) {
+		--tcp->npipe;
+		ny_io_close(tcp->pipes[tcp->npipe][0]);
+		ny_io_close(tcp->pipes[tcp->npipe][1]);
+	}
+
+	tcp->pid = getpid();
+
+	ret = 0;
+	goto exit;
+
+relay:
+	ny_alloc_destroy(&alloc_relay);
+
+seg:
+	ny_alloc_destroy(&alloc_seg);
+
+con:
+	ny_alloc_destroy(&alloc_con);
+
+exit:
+	return ret;
+}
+
+/**
+ * \brief Worker start handler
+ *
+ * \param[in,out] hook Worker hook
+ * \param[in] worker Worker index
+ *
+ * \return Zero on success or non-zero on error
+ */
+static int worker_event(struct ny_hook *restrict hook, unsigned worker) {
+	(void) worker;
+
+	struct ny_tcp *tcp = (struct ny_tcp *) hook->data;
+
+	int _;
+	int ret = -1;
+
+	/* Pools and sockets of a context created in this process are not shared */
+	bool local = tcp->pid == getpid();
+	if (!local) {
+		if (unlikely(pool_renew(tcp)))
+			goto exit;
+	}
+
+	for (unsigned iter = 0; iter < tcp->nsock; ++iter) {
+		struct ny_tcp_sock *sock = tcp->sock + iter;
+		int parent = sock->io.fd;
+
+		/* Listening socket is shared between workers */
+		if (sock_shared(tcp, sock) || ev_is_active(&sock->io))
+			continue;
+
+		/* Listen on the reserved socket itself */
+		if (local) {
+			if (unlikely(sock_listen(tcp, sock, parent)))
+				goto exit;
+
+			continue;
+		}
+
+		/* Open listening socket of this worker */
+		int fd = sock_bind(tcp, (struct sockaddr const *) &sock->address,
+			sock->addrlen);
+		if (unlikely(fd < 0))
+			goto exit;
+
+		if (unlikely(sock_listen(tcp, sock, fd))) {
+			ny_io_close(fd);
+			goto exit;
+		}
+
+		/* Release the socket inherited from the parent */
+		_ = ny_io_close(parent);
+		assert(!_);
+	}
+
+	ret = 0;
+
+exit:
+	return ret;
+}
+
+/**
+ * \brief Binary upgrade handler
+ *
+ * \param[in,out] hook Worker hook
+ */
+static void exec_event(struct ny_hook *restrict hook) {
+	struct ny_tcp *tcp = (struct ny_tcp *) hook->data;
+
+	for (unsigned iter = 0; iter < tcp->nsock; ++iter) {
+		if (tcp->sock[iter].io.fd >= 0)
+			ny_inherit_fd(tcp->sock[iter].io.fd);
+	}
+}
+
+/**
+ * \brief Drain handler
+ *
+ * \param[in,out] hook Worker hook
+ * \param[in] force Close remaining connections
+ */
+static void drain_event(struct ny_hook *restrict hook, bool force) {
+	struct ny_tcp *tcp = (struct ny_tcp *) hook->data;
+
+	if (force) {
+		/* Close connections that outlived the deadline */
+		for (unsigned iter = 0; iter < NY_TCP_WHEEL_SIZE; ++iter) {
+			while (tcp->wheel[iter])
+				ny_tcp_con_destroy(tcp->wheel[iter]);
+		}
+	}
+	else {
+		/* Stop accepting connections */
+		listen_stop(tcp);
+		tcp->paused = false;
+
+		/* Close idle upstream connections, they would outlive the deadline */
+		for (unsigned iter = 0; iter < NY_TCP_WHEEL_SIZE; ++iter) {
+			for (struct ny_tcp_con *con = tcp->wheel[iter], *next; con;
+				con = next) {
+				next = con->next;
+
+				if (con->idle_prev)
+					ny_tcp_con_destroy(con);
+			}
+		}
+
+		if (tcp->reuseport) {
+			/*
+			 * Take over connections queued on the sockets of this worker
+			 * and close them, so that the kernel stops routing connections
+			 * to them
+			 */
+			for (unsigned iter = 0; iter < tcp->nsock; ++iter) {
+				struct ny_tcp_sock *sock = tcp->sock + iter;
+
+				if (!sock_shared(tcp, sock) && sock->io.fd >= 0) {
+					accept_batch(tcp, sock->io.fd, UINT_MAX);
+					sock_close(tcp, sock);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * \brief Drain progress handler
+ *
+ * \param[in] hook Worker hook
+ *
+ * \return Whether live connections remain
+ */
+static bool busy_event(struct ny_hook const *restrict hook) {
+	struct ny_tcp const *tcp = (struct ny_tcp const *) hook->data;
+
+	return tcp->ncon;
+}
+
+int ny_tcp_init(struct ny_tcp *restrict tcp, struct ny *restrict ny,
+	char const *restrict node, char const *restrict service,
+	uint_least32_t maxcon) {
+	assert(tcp);
+	assert(ny);
+
+	int _;
+	int ret = -1;
+
+	/* Initialise structure */
+	tcp->data = NULL;
+	tcp->ny = ny;
+	tcp->maxcon = maxcon;
+	tcp->ncon = 0;
+	tcp->pid = getpid();
+	tcp->tick = 0;
+	tcp->accept_max = NY_TCP_ACCEPT_MAX;
+	tcp->paused = false;
+	tcp->dirty = NULL;
+	tcp->starved = NULL;
+	tcp->starved_last = &tcp->starved;
+	tcp->nsock = 0;
+	tcp->npipe = 0;
+	tcp->reuseport = false;
+	tcp->edge = false;
+	tcp->defer_accept = 0;
+	tcp->fastopen = 0;
+	memset(&tcp->opt, 0, sizeof tcp->opt);
+	tcp->admit = NULL;
+	tcp->tcp_error = NULL;
+	tcp->tcp_connect = NULL;
+	tcp->con_error = NULL;
+	tcp->con_destroy = NULL;
+	tcp->con_connect = NULL;
+	tcp->con_readable = NULL;
+	tcp->con_writable = NULL;
+	tcp->con_timeout = NULL;
+	tcp->con_relayed = NULL;
+
+	/* Initialise worker hook */
+	tcp->hook.data = tcp;
+	tcp->hook.next = NULL;
+	tcp->hook.worker = worker_event;
+	tcp->hook.exec = exec_event;
+	tcp->hook.drain = drain_event;
+	tcp->hook.busy = busy_event;
+
+	/* Resolve address */
+	if (node || service) {
+		_ = ny_tcp_bind(tcp, node, service);
+		if (unlikely(_))
+			goto exit;
+	}
+
+	/* Initialise timing wheel */
+	assert(timeout_ticks() < NY_TCP_WHEEL_SIZE);
+	for (unsigned iter = 0; iter < NY_TCP_WHEEL_SIZE; ++iter)
+		tcp->wheel[iter] = NULL;
+
+	ev_init(&tcp->timer, wheel_event);
+	tcp->timer.repeat = NY_TCP_WHEEL_TICK;
+	ev_set_priority(&tcp->timer, NY_TCP_TIMER_PRIO);
+	tcp->timer.data = tcp;
+
+	/* Initialise flush watcher */
+	ev_prepare_init(&tcp->flush, flush_event);
+	tcp->flush.data = tcp;
+
+	/* Initialise pool trim watcher */
+	ev_timer_init(&tcp->trim, trim_event, NY_TCP_TRIM_INTERVAL,
+		NY_TCP_TRIM_INTERVAL);
+	ev_set_priority(&tcp->trim, NY_TCP_TIMER_PRIO);
+	tcp->trim.data = tcp;
+
+	/* Initialise allocators */
+	_ = ny_alloc_init_grow(&tcp->alloc_con, ny, maxcon,
+		sizeof (struct ny_tcp_con));
+	if (unlikely(_))
+		goto free;
+
+	_ = ny_alloc_init_grow(&tcp->alloc_seg, ny, seg_number(maxcon),
+		NY_TCP_SEG_SIZE);
+	if (unlikely(_)) {
+		ny_alloc_destroy(&tcp->alloc_con);
+		goto free;
+	}
+
+	_ = ny_alloc_init(&tcp->alloc_relay, ny, maxcon,
+		sizeof (struct ny_tcp_relay));
+	if (unlikely(_)) {
+		ny_alloc_destroy(&tcp->alloc_seg);
+		ny_alloc_destroy(&tcp->alloc_con);
+		goto free;
+	}
+
+	_ = ny_alloc_init_grow(&tcp->alloc_buf, ny, buf_number(maxcon),
+		NY_TCP_BUF_SIZE);
+	if (unlikely(_)) {
+		ny_alloc_destroy(&tcp->alloc_relay);
+		ny_alloc_destroy(&tcp->alloc_seg);
+		ny_alloc_destroy(&tcp->alloc_con);
+		goto free;
+	}
+
+	/* Duplicate standard input as a reserve file descriptor */
+	tcp->goat = goat_new();
+
+	/* Trim pools without keeping the event loop alive */
+	ev_timer_start(ny->loop, &tcp->trim);
+	ev_unref(ny->loop);
+
+	ret = 0;
+	goto exit;
+
+free:
+	if (tcp->nsock) {
+		freeaddrinfo(tcp->sock[0].res);
+		tcp->sock[0].res = NULL;
+		tcp->nsock = 0;
+	}
+
+exit:
+	return ret;
+}
+
+void ny_tcp_destroy(struct ny_tcp *restrict tcp) {
+	assert(tcp);
+
+	int _;
+
+	/* Stop taking part in worker startup */
+	ny_hook_remove(tcp->ny, &tcp->hook);
+
+	/* Stop timing wheel */
+	ev_timer_stop(tcp->ny->loop, &tcp->timer);
+
+	/* Stop flush watcher */
+	ev_prepare_stop(tcp->ny->loop, &tcp->flush);
+
+	/* Stop pool trim watcher */
+	ev_ref(tcp->ny->loop);
+	ev_timer_stop(tcp->ny->loop, &tcp->trim);
+
+	for (unsigned iter = 0; iter < tcp->nsock; ++iter) {
+		/* Close socket */
+		sock_close(tcp, tcp->sock + iter);
+
+		/* Free unbound addresses */
+		if (tcp->sock[iter].res)
+			freeaddrinfo(tcp->sock[iter].res);
+	}
+
+	/* Close idle relay pipes */
+	while (tcp->npipe) {
+		--tcp->npipe;
+		ny_io_close(tcp->pipes[tcp->npipe][0]);
+		ny_io_close(tcp->pipes[tcp->npipe][1]);
+	}
+
+	/* Destroy allocators */
+	ny_alloc_destroy(&tcp->alloc_buf);
+	ny_alloc_destroy(&tcp->alloc_relay);
+	ny_alloc_destroy(&tcp->alloc_seg);
+	ny_alloc_destroy(&tcp->alloc_con);
+
+	/* Close reserve file descriptor */
+	_ = ny_io_close(tcp->goat);
+	assert(!_);
+}
+
+int ny_tcp_bind(struct ny_tcp *restrict tcp,
+	char const *restrict node, char const *restrict service) {
+	assert(tcp);
+
+	int _;
+	int ret = -1;
+
+	if (unlikely(tcp->nsock >= NY_TCP_SOCK_MAX)) {
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, ERANGE);
+		goto exit;
+	}
+
+	struct ny_tcp_sock *sock = tcp->sock + tcp->nsock;
+
+	/* Resolve address */
+	_ = getaddrinfo(node, service, &hints, &sock->res);
+	if (unlikely(_)) {
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_GAI, _);
+		sock->res = NULL;
+		goto exit;
+	}
+
+	/* All resolved addresses are IPv6 */
+	sock->address.ss_family = AF_INET6;
+	sock_init(tcp, sock);
+
+	++tcp->nsock;
+
+	ret = 0;
+
+exit:
+	return ret;
+}
+
+int ny_tcp_bind_unix(struct ny_tcp *restrict tcp,
+	char const *restrict path) {
+	assert(tcp);
+	assert(path);
+	assert(*path);
+
+	int ret = -1;
+
+	if (unlikely(tcp->nsock >= NY_TCP_SOCK_MAX)) {
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, ERANGE);
+		goto exit;
+	}
+
+	struct ny_tcp_sock *sock = tcp->sock + tcp->nsock;
+	struct sockaddr_un *address = (struct sockaddr_un *) &sock->address;
+
+	size_t length = strlen(path);
+	if (unlikely(length >= sizeof address->sun_path)) {
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, ENAMETOOLONG);
+		goto exit;
+	}
+
+	/* Set address without resolution */
+	memset(address, 0, sizeof *address);
+	address->sun_family = AF_UNIX;
+	memcpy(address->sun_path, path, length + 1);
+	sock->addrlen = offsetof (struct sockaddr_un, sun_path) + length + 1;
+	sock->res = NULL;
+	sock_init(tcp, sock);
+
+	++tcp->nsock;
+
+	ret = 0;
+
+exit:
+	return ret;
+}
+
+int ny_tcp_listen(struct ny_tcp *restrict tcp) {
+	assert(tcp);
+	assert(tcp->nsock);
+
+	int ret = -1;
+
+	unsigned iter;
+	for (iter = 0; iter < tcp->nsock; ++iter) {
+		struct ny_tcp_sock *sock = tcp->sock + iter;
+
+		/* Bind to the first usable address */
+		int fd = -1;
+		for (struct addrinfo *rp = sock->res; rp; rp = rp->ai_next) {
+			fd = sock_open(tcp, rp->ai_addr, rp->ai_addrlen);
+			if (likely(fd >= 0)) {
+				assert(rp->ai_addrlen <= sizeof sock->address);
+				memcpy(&sock->address, rp->ai_addr, rp->ai_addrlen);
+				sock->addrlen = rp->ai_addrlen;
+				break;
+			}
+		}
+
+		/* Address was not resolved */
+		if (!sock->res) {
+			fd = sock_open(tcp, (struct sockaddr const *) &sock->address,
+				sock->addrlen);
+		}
+
+		if (unlikely(fd < 0))
+			goto close;
+
+		if (!sock_shared(tcp, sock)) {
+			/*
+			 * Keep the address reserved in the parent without listening,
+			 * so that connections are only queued on the sockets of the
+			 * workers
+			 */
+			ev_io_set(&sock->io, fd, EV_READ);
+		}
+		else if (unlikely(sock_listen(tcp, sock, fd))) {
+			ny_io_close(fd);
+			goto close;
+		}
+	}
+
+	/* Free resolved addresses */
+	for (iter = 0; iter < tcp->nsock; ++iter) {
+		if (tcp->sock[iter].res) {
+			freeaddrinfo(tcp->sock[iter].res);
+			tcp->sock[iter].res = NULL;
+		}
+	}
+
+	/* Take part in worker startup */
+	ny_hook_add(tcp->ny, &tcp->hook);
+
+	ret = 0;
+	goto exit;
+
+close:
+	/* Close sockets bound so far */
+	while (iter--)
+		sock_close(tcp, tcp->sock + iter);
+
+exit:
+	return ret;
+}
+
+struct ny_tcp_con *ny_tcp_connect(struct ny_tcp *restrict tcp,
+	struct sockaddr const *restrict address, socklen_t addrlen) {
+	assert(tcp);
+	assert(address);
+
+	/* Allocate memory for connection structure */
+	struct ny_tcp_con *con = ny_alloc_acquire(&tcp->alloc_con);
+	if (unlikely(!con)) {
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, ENOBUFS);
+		goto exit;
+	}
+
+	/* Create socket */
+	int fd = socket(address->sa_family, SOCK_STREAM,
+		address->sa_family == AF_UNIX ? 0 : IPPROTO_TCP);
+	if (unlikely(fd < 0)) {
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+		goto release;
+	}
+
+	/* Close socket on exec */
+	ny_io_fd_set(fd, FD_CLOEXEC);
+
+	/* Mark socket as non-blocking */
+	ny_io_fl_set(fd, O_NONBLOCK);
+
+	/* Apply socket options */
+	if (address->sa_family != AF_UNIX)
+		con_tune(tcp, fd);
+
+	/* Initiate connection */
+	if (connect(fd, address, addrlen) && errno != EINPROGRESS &&
+		errno != EINTR) {
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+		ny_io_close(fd);
+		goto release;
+	}
+
+	con_init(tcp, con, fd);
+
+	/* Wait for socket to become writable, queueing output meanwhile */
+	con->connecting = true;
+	con->blocked = true;
+	con_arm(con);
+
+	goto exit;
+
+release:
+	ny_alloc_release(&tcp->alloc_con, con);
+	con = NULL;
+
+exit:
+	return con;
+}
+
+void ny_tcp_con_destroy(struct ny_tcp_con *restrict con) {
+	assert(con);
+
+	/* Call destroy event handler */
+	if (con->tcp->con_destroy)
+		con->tcp->con_destroy(con);
+
+	/* Stop watcher */
+	ev_io_stop(con->tcp->ny->loop, &con->io);
+
+	/* Stop relaying from this connection */
+	if (con->relay) {
+		struct ny_tcp_con *dst = con->relay->dst;
+
+		relay_free(con->relay);
+		if (dst)
+			con_arm(dst);
+	}
+
+	/* Source of relay into this connection is notified last */
+	struct ny_tcp_con *src = NULL;
+	if (con->relay_in) {
+		src = con->relay_in->src;
+
+		relay_free(con->relay_in);
+		con_arm(src);
+	}
+
+	/* Leave upstream pool */
+	if (con->idle_prev)
+		idle_unlink(con);
+
+	/* Discard output queue */
+	if (con->dirty_prev)
+		flush_unlink(con);
+	con_discard(con);
+
+	/* Return lent receive buffer or stop waiting for one */
+	if (con->starved_prev)
+		starved_unlink(con);
+	if (con->lent)
+		lent_return(con);
+
+	/* Unlink from timing wheel */
+	wheel_unlink(con);
+	if (!--con->tcp->ncon)
+		ev_timer_stop(con->tcp->ny->loop, &con->tcp->timer);
+
+	/* Close socket */
+	ny_io_close(con->io.fd);
+
+	struct ny_tcp *tcp = con->tcp;
 
-	/* Duplicate standard input as a reserve file descriptor */
-	tcp->goat = goat_new();
+	/* Leave admission table */
+	if (tcp->admit)
+		ny_admit_release(tcp->admit, con->admit);
 
-	ret = 0;
+	/* Free structure */
+	ny_alloc_release(&tcp->alloc_con, con);
 
-exit:
-	if (likely(res))
-		freeaddrinfo(res);
+	/* Resume listener paused for lack of connection structures */
+	if (unlikely(tcp->paused) && likely(!tcp->ny->drain)) {
+		tcp->paused = false;
+		listen_start(tcp);
+	}
 
-	return ret;
+	/* Raise relay end handler */
+	if (src && src->tcp->con_relayed) {
+		struct ny_error error;
+		ny_error_set(&error, NY_ERROR_DOMAIN_ERRNO, EPIPE);
+		src->tcp->con_relayed(src, &error);
+	}
 }
 
-void ny_tcp_destroy(struct ny_tcp *restrict tcp) {
-	assert(tcp);
-
-	int _;
+void ny_tcp_con_touch(struct ny_tcp_con *restrict con) {
+	assert(con);
 
-	/* Close socket */
-	_ = ny_io_close(tcp->io.fd);
-	assert(_);
+	/* Connection is checked lazily when its wheel bucket is due */
+	con->touched = con->tcp->tick;
+}
 
-	/* Destroy allocator */
-	ny_alloc_destroy(&tcp->alloc_con);
+void ny_tcp_con_events(struct ny_tcp_con *restrict con, int events) {
+	assert(con);
+	assert(events);
+	assert((events & ~(NY_TCP_READABLE | NY_TCP_WRITABLE)) == 0);
 
-	/* Close reserve file descriptor */
-	_ = ny_io_close(tcp->goat);
-	assert(_);
+	con->events = events;
+	con_arm(con);
 }
 
-int ny_tcp_listen(struct ny_tcp *restrict tcp) {
-	assert(tcp);
+int ny_tcp_con_cork(struct ny_tcp_con *restrict con, bool cork) {
+	assert(con);
 
 	int ret = -1;
 
-	/* Listen on socket */
-	if (listen(tcp->io.fd, SOMAXCONN)) {
-		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+#if NY_TCP_CORK
+	int value = cork;
+	if (unlikely(setsockopt(con->io.fd, IPPROTO_TCP, NY_TCP_CORK, &value,
+		sizeof (value)))) {
+		ny_error_set(&con->tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
 		goto exit;
 	}
 
-	ev_io_start(tcp->ny->loop, &tcp->io);
-
 	ret = 0;
+#else
+	ny_error_set(&con->tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, ENOSYS);
+	goto exit;
+#endif
 
 exit:
 	return ret;
 }
 
-void ny_tcp_con_destroy(struct ny_tcp_con *restrict con) {
-	assert(con);
+#if NY_TCP_INFO
+/**
+ * \brief Sample connection information
+ *
+ * \param[in,out] con Connection
+ *
+ * \return Pointer to sample or null with \c errno set on error
+ */
+static struct ny_tcp_info const *con_sample(struct ny_tcp_con *restrict con) {
+	struct ny_tcp_info const *info = NULL;
 
-	/* Call destroy event handler */
-	if (con->tcp->con_destroy)
-		con->tcp->con_destroy(con);
+	ev_tstamp now = ev_now(con->tcp->ny->loop);
 
-	/* Stop watchers */
-	ev_io_stop(con->tcp->ny->loop, &con->io);
-	ev_timer_stop(con->tcp->ny->loop, &con->timer);
+	/* Rate limit sampling */
+	if (now - con->info.stamp < NY_TCP_INFO_INTERVAL) {
+		info = &con->info;
+		goto exit;
+	}
 
-	/* Close socket */
-	ny_io_close(con->io.fd);
+	struct tcp_info raw;
+	socklen_t length = sizeof raw;
+	if (unlikely(getsockopt(con->io.fd, IPPROTO_TCP, TCP_INFO, &raw,
+		&length)))
+		goto exit;
 
-	/* Free structure */
-	ny_alloc_release(&con->tcp->alloc_con, con);
+	con->info.stamp = now;
+	con->info.rtt = raw.tcpi_rtt;
+	con->info.rttvar = raw.tcpi_rttvar;
+	con->info.retrans = raw.tcpi_total_retrans;
+	con->info.cwnd = raw.tcpi_snd_cwnd;
+	con->info.unacked = raw.tcpi_unacked;
+
+	info = &con->info;
+
+exit:
+	return info;
 }
+#endif
 
-void ny_tcp_con_touch(struct ny_tcp_con *restrict con) {
+struct ny_tcp_info const *ny_tcp_con_info(struct ny_tcp_con *restrict con) {
 	assert(con);
 
-	/* Reset timeout timer */
-	ev_timer_again(con->tcp->ny->loop, &con->timer);
+	struct ny_tcp *tcp = con->tcp;
+	struct ny_tcp_info const *info = NULL;
+
+#if NY_TCP_INFO
+	info = con_sample(con);
+	if (unlikely(!info))
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
+#else
+	ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, ENOSYS);
+#endif
+
+	return info;
 }
 
-void ny_tcp_con_events(struct ny_tcp_con *restrict con, int events) {
-	assert(con);
-	assert(events);
-	assert((events & ~(NY_TCP_READABLE | NY_TCP_WRITABLE)) == 0);
+int ny_tcp_stats(struct ny_tcp *restrict tcp,
+	struct ny_tcp_stats *restrict stats) {
+	assert(tcp);
+	assert(stats);
 
-	ev_io_stop(con->tcp->ny->loop, &con->io);
-	ev_io_set(&con->io, &con->io.fd, events);
-	ev_io_start(con->tcp->ny->loop, &con->io);
+	int ret = -1;
+
+	memset(stats, 0, sizeof *stats);
+
+#if NY_TCP_INFO
+	/* Every live connection is linked into the timing wheel */
+	for (size_t iter = 0; iter < NY_TCP_WHEEL_SIZE; ++iter) {
+		for (struct ny_tcp_con *con = tcp->wheel[iter]; con; con = con->next) {
+			if (con->connecting)
+				continue;
+
+			struct ny_tcp_info const *info = con_sample(con);
+
+			/* Not a TCP socket */
+			if (!info)
+				continue;
+
+			++stats->ncon;
+			++stats->rtt[hist_bucket(info->rtt)];
+			++stats->retrans[hist_bucket(info->retrans)];
+			++stats->cwnd[hist_bucket(info->cwnd)];
+			++stats->unacked[hist_bucket(info->unacked)];
+		}
+	}
+
+	ret = 0;
+#else
+	ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, ENOSYS);
+#endif
+
+	return ret;
 }
 
 ssize_t ny_tcp_con_recv(struct ny_tcp_con *restrict con,
@@ -394,6 +2405,79 @@ ssize_t ny_tcp_con_recv_vec(struct ny_tcp_con *restrict con,
 	return rlen;
 }
 
+ssize_t ny_tcp_con_recv_lent(struct ny_tcp_con *restrict con,
+	uint8_t const **restrict data) {
+	assert(con);
+	assert(data);
+
+	struct ny_tcp *tcp = con->tcp;
+
+	ssize_t ret = -1;
+
+	/* Borrow buffer only once data is arriving */
+	if (!con->lent) {
+		con->lent = ny_alloc_acquire(&tcp->alloc_buf);
+		if (unlikely(!con->lent)) {
+			/* Stop reading until a buffer is returned */
+			if (!con->starved_prev) {
+				starved_link(con);
+				con_arm(con);
+			}
+
+			ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, ENOBUFS);
+			goto exit;
+		}
+
+		con->lent_start = 0;
+		con->lent_end = 0;
+	}
+
+	/* Move unconsumed data to the front to make room */
+	if (con->lent_end == NY_TCP_BUF_SIZE && con->lent_start) {
+		memmove(con->lent, con->lent + con->lent_start,
+			con->lent_end - con->lent_start);
+		con->lent_end -= con->lent_start;
+		con->lent_start = 0;
+	}
+
+	if (con->lent_end < NY_TCP_BUF_SIZE) {
+		ssize_t rlen = ny_tcp_con_recv(con, con->lent + con->lent_end,
+			NY_TCP_BUF_SIZE - con->lent_end);
+
+		/* Report error once no data is left */
+		if (unlikely(rlen < 0)) {
+			if (con->lent_start == con->lent_end) {
+				lent_return(con);
+				goto exit;
+			}
+		}
+		else
+			con->lent_end += rlen;
+	}
+
+	*data = con->lent + con->lent_start;
+	ret = con->lent_end - con->lent_start;
+
+	/* Nothing received */
+	if (!ret)
+		lent_return(con);
+
+exit:
+	return ret;
+}
+
+void ny_tcp_con_recv_done(struct ny_tcp_con *restrict con, size_t length) {
+	assert(con);
+	assert(con->lent);
+	assert(length <= con->lent_end - con->lent_start);
+
+	con->lent_start += length;
+
+	/* Reclaim buffer once consumed */
+	if (con->lent_start == con->lent_end)
+		lent_return(con);
+}
+
 ssize_t ny_tcp_con_send(struct ny_tcp_con *restrict con,
 	void const *restrict buffer, size_t length) {
 	assert(con);
@@ -401,8 +2485,13 @@ ssize_t ny_tcp_con_send(struct ny_tcp_con *restrict con,
 
 	ssize_t wlen = ny_io_write(con->io.fd, buffer, length);
 	if (unlikely(wlen < 0)) {
-		if (errno == EINTR || errno == EWOULDBLOCK)
+		if (errno == EINTR || errno == EWOULDBLOCK) {
 			wlen = 0;
+
+			/* Wait for socket to become writable */
+			if (con->tcp->edge && errno == EWOULDBLOCK)
+				con_want_write(con);
+		}
 		else
 			ny_error_set(&con->tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
 	}
@@ -421,8 +2510,13 @@ ssize_t ny_tcp_con_send_vec(struct ny_tcp_con *restrict con,
 
 	ssize_t wlen = ny_io_writev(con->io.fd, vector, count);
 	if (unlikely(wlen < 0)) {
-		if (errno == EINTR || errno == EWOULDBLOCK)
+		if (errno == EINTR || errno == EWOULDBLOCK) {
 			wlen = 0;
+
+			/* Wait for socket to become writable */
+			if (con->tcp->edge && errno == EWOULDBLOCK)
+				con_want_write(con);
+		}
 		else
 			ny_error_set(&con->tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
 	}
@@ -434,6 +2528,52 @@ ssize_t ny_tcp_con_send_vec(struct ny_tcp_con *restrict con,
 	return wlen;
 }
 
+int ny_tcp_con_write_file(struct ny_tcp_con *restrict con, int fd,
+	size_t length, off_t offset, void (*release)(void *), void *arg) {
+	assert(con);
+	assert(fd >= 0);
+	assert(offset >= 0);
+
+	struct ny_tcp *tcp = con->tcp;
+
+	int ret = -1;
+
+	/* Nothing to send */
+	if (unlikely(!length)) {
+		if (release)
+			release(arg);
+
+		ret = 0;
+		goto exit;
+	}
+
+	struct ny_tcp_seg *seg = ny_alloc_acquire(&tcp->alloc_seg);
+	if (unlikely(!seg)) {
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, ENOBUFS);
+		goto exit;
+	}
+
+	/* Reference file contents */
+	seg->base = NULL;
+	seg->start = 0;
+	seg->end = length;
+	seg->fd = fd;
+	seg->offset = offset;
+	seg->release = release;
+	seg->arg = arg;
+	con_append(con, seg);
+	con->queued += length;
+
+	/* Flush before the event loop blocks unless waiting for the socket */
+	if (!con->blocked && !con->dirty_prev)
+		flush_link(tcp, con);
+
+	ret = 0;
+
+exit:
+	return ret;
+}
+
 ssize_t ny_tcp_con_sendfile(struct ny_tcp_con *restrict con,
 	int fd, size_t length, off_t offset) {
 	assert(con);
@@ -441,8 +2581,13 @@ ssize_t ny_tcp_con_sendfile(struct ny_tcp_con *restrict con,
 
 	ssize_t wlen = ny_io_sendfile(con->io.fd, fd, length, offset);
 	if (unlikely(wlen < 0)) {
-		if (errno == EINTR || errno == EWOULDBLOCK)
+		if (errno == EINTR || errno == EWOULDBLOCK) {
 			wlen = 0;
+
+			/* Wait for socket to become writable */
+			if (con->tcp->edge && errno == EWOULDBLOCK)
+				con_want_write(con);
+		}
 		else
 			ny_error_set(&con->tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, errno);
 	}
@@ -453,3 +2598,323 @@ ssize_t ny_tcp_con_sendfile(struct ny_tcp_con *restrict con,
 
 	return wlen;
 }
+
+int ny_tcp_con_write(struct ny_tcp_con *restrict con,
+	void const *restrict buffer, size_t length) {
+	assert(con);
+	assert(buffer);
+
+	struct iovec vector = {
+		.iov_base = (void *) buffer,
+		.iov_len = length
+	};
+
+	return ny_tcp_con_write_vec(con, &vector, 1);
+}
+
+int ny_tcp_con_write_vec(struct ny_tcp_con *restrict con,
+	struct iovec const *restrict vector, size_t count) {
+	assert(con);
+	assert(vector);
+
+	struct ny_tcp *tcp = con->tcp;
+
+	int ret = -1;
+
+	/* Remember end of output queue for rollback */
+	struct ny_tcp_seg *last = con->last;
+	size_t end = last ? last->end : 0;
+	size_t queued = con->queued;
+
+	for (size_t iter = 0; iter < count; ++iter) {
+		uint8_t const *data = vector[iter].iov_base;
+		size_t length = vector[iter].iov_len;
+
+		while (length) {
+			struct ny_tcp_seg *seg = con->last;
+
+			/* Append segment if the last one is full or referenced */
+			if (!seg || seg->release || seg->end == seg_capacity()) {
+				seg = ny_alloc_acquire(&tcp->alloc_seg);
+				if (unlikely(!seg)) {
+					ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, ENOBUFS);
+					goto rollback;
+				}
+
+				seg->base = seg->data;
+				seg->start = 0;
+				seg->end = 0;
+				seg->release = NULL;
+				con_append(con, seg);
+			}
+
+			size_t chunk = seg_capacity() - seg->end;
+			if (chunk > length)
+				chunk = length;
+
+			memcpy(seg->data + seg->end, data, chunk);
+			seg->end += chunk;
+			con->queued += chunk;
+
+			data += chunk;
+			length -= chunk;
+		}
+	}
+
+	/* Flush before the event loop blocks unless waiting for the socket */
+	if (con->out && !con->blocked && !con->dirty_prev)
+		flush_link(tcp, con);
+
+	ret = 0;
+	goto exit;
+
+rollback:
+	/* Release segments appended by this call */
+	for (struct ny_tcp_seg *seg = last ? last->next : con->out, *next; seg;
+		seg = next) {
+		next = seg->next;
+		ny_alloc_release(&tcp->alloc_seg, seg);
+	}
+
+	if (last) {
+		last->next = NULL;
+		last->end = end;
+	}
+	else
+		con->out = NULL;
+
+	con->last = last;
+	con->queued = queued;
+
+exit:
+	return ret;
+}
+
+int ny_tcp_con_write_zerocopy(struct ny_tcp_con *restrict con,
+	void const *restrict buffer, size_t length, void (*release)(void *),
+	void *arg) {
+	assert(con);
+	assert(buffer);
+	assert(release);
+
+	int ret = -1;
+
+#if NY_TCP_ZEROCOPY
+	if (length >= NY_TCP_ZEROCOPY_MIN) {
+		struct ny_tcp *tcp = con->tcp;
+
+		/* Enable zero-copy transmission on first use */
+		if (!con->zerocopy) {
+			int value = 1;
+			con->zerocopy = setsockopt(con->io.fd, SOL_SOCKET, SO_ZEROCOPY,
+				&value, sizeof (value)) ? -1 : 1;
+		}
+
+		if (con->zerocopy > 0) {
+			struct ny_tcp_seg *seg = ny_alloc_acquire(&tcp->alloc_seg);
+			if (unlikely(!seg)) {
+				ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, ENOBUFS);
+				goto exit;
+			}
+
+			/* Reference payload */
+			seg->base = buffer;
+			seg->start = 0;
+			seg->end = length;
+			seg->release = release;
+			seg->arg = arg;
+			con_append(con, seg);
+			con->queued += length;
+
+			/* Flush before the event loop blocks unless waiting for the socket */
+			if (!con->blocked && !con->dirty_prev)
+				flush_link(tcp, con);
+
+			ret = 0;
+			goto exit;
+		}
+	}
+#endif
+
+	/* Copy small payloads or if zero-copy transmission is unavailable */
+	ret = ny_tcp_con_write(con, buffer, length);
+	if (likely(!ret))
+		release(arg);
+
+#if NY_TCP_ZEROCOPY
+exit:
+#endif
+	return ret;
+}
+
+/**
+ * \brief Start relay
+ *
+ * \param[in,out] src Source connection
+ * \param[in,out] dst Destination connection or null
+ * \param[in] fd Destination file if \p dst is null
+ * \param[in] offset Destination file offset
+ *
+ * \return Zero on success or non-zero on error
+ */
+static int relay_start(struct ny_tcp_con *restrict src,
+	struct ny_tcp_con *restrict dst, int fd, off_t offset) {
+	assert(src);
+	assert(!src->relay);
+	assert(!dst || !dst->relay_in);
+	assert(src != dst);
+
+	struct ny_tcp *tcp = src->tcp;
+
+	int ret = -1;
+
+#if NY_TCP_SPLICE
+	struct ny_tcp_relay *relay = ny_alloc_acquire(&tcp->alloc_relay);
+	if (unlikely(!relay)) {
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, ENOBUFS);
+		goto exit;
+	}
+
+	if (unlikely(pipe_acquire(tcp, relay->pipe))) {
+		ny_alloc_release(&tcp->alloc_relay, relay);
+		goto exit;
+	}
+
+	relay->src = src;
+	relay->dst = dst;
+	relay->fd = fd;
+	relay->offset = offset;
+	relay->pending = 0;
+	relay->eof = false;
+	relay->wait = false;
+
+	src->relay = relay;
+	if (dst)
+		dst->relay_in = relay;
+
+	/* Read interest is taken over by the relay */
+	con_arm(src);
+
+	ret = 0;
+#else
+	ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_ERRNO, ENOSYS);
+	goto exit;
+#endif
+
+exit:
+	return ret;
+}
+
+int ny_tcp_con_relay(struct ny_tcp_con *restrict src,
+	struct ny_tcp_con *restrict dst) {
+	assert(dst);
+
+	return relay_start(src, dst, -1, 0);
+}
+
+int ny_tcp_con_relay_file(struct ny_tcp_con *restrict src, int fd,
+	off_t offset) {
+	assert(fd >= 0);
+
+	return relay_start(src, NULL, fd, offset);
+}
+
+int ny_tcp_upstream_init(struct ny_tcp_upstream *restrict upstream,
+	struct ny_tcp *restrict tcp, char const *restrict node,
+	char const *restrict service, unsigned maxidle) {
+	assert(upstream);
+	assert(tcp);
+
+	int _;
+	int ret = -1;
+
+	/* Initialise structure */
+	upstream->data = NULL;
+	upstream->tcp = tcp;
+	upstream->idle = NULL;
+	upstream->nidle = 0;
+	upstream->maxidle = maxidle;
+
+	struct addrinfo const hints = {
+		.ai_flags = AI_ADDRCONFIG,
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM
+	};
+
+	/* Resolve address */
+	struct addrinfo *res;
+	_ = getaddrinfo(node, service, &hints, &res);
+	if (unlikely(_)) {
+		ny_error_set(&tcp->ny->error, NY_ERROR_DOMAIN_GAI, _);
+		goto exit;
+	}
+
+	/* Use the first address */
+	assert(res->ai_addrlen <= sizeof upstream->address);
+	memcpy(&upstream->address, res->ai_addr, res->ai_addrlen);
+	upstream->addrlen = res->ai_addrlen;
+
+	freeaddrinfo(res);
+
+	ret = 0;
+
+exit:
+	return ret;
+}
+
+void ny_tcp_upstream_destroy(struct ny_tcp_upstream *restrict upstream) {
+	assert(upstream);
+
+	/* Close idle connections */
+	while (upstream->idle)
+		ny_tcp_con_destroy(upstream->idle);
+}
+
+struct ny_tcp_con *ny_tcp_upstream_acquire(
+	struct ny_tcp_upstream *restrict upstream) {
+	assert(upstream);
+
+	struct ny_tcp_con *con;
+	while ((con = upstream->idle)) {
+		/* Check connection for closure or stray data */
+		if (unlikely(!con_alive(con))) {
+			ny_tcp_con_destroy(con);
+			continue;
+		}
+
+		idle_unlink(con);
+		ny_tcp_con_touch(con);
+		goto exit;
+	}
+
+	/* Open new connection */
+	con = ny_tcp_connect(upstream->tcp,
+		(struct sockaddr const *) &upstream->address, upstream->addrlen);
+	if (likely(con))
+		con->upstream = upstream;
+
+exit:
+	return con;
+}
+
+void ny_tcp_upstream_release(struct ny_tcp_con *restrict con) {
+	assert(con);
+	assert(con->upstream);
+	assert(!con->idle_prev);
+
+	/* Connection can not be reused or worker is draining */
+	if (con->queued || con->connecting ||
+		con->upstream->nidle >= con->upstream->maxidle ||
+		con->tcp->ny->drain) {
+		ny_tcp_con_destroy(con);
+		return;
+	}
+
+	con->data = NULL;
+
+	/* Only watch for closure */
+	ny_tcp_con_events(con, NY_TCP_READABLE);
+	ny_tcp_con_touch(con);
+
+	idle_link(con);
+}
@@ -0,0 +1,79 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/admit.h>
+
+static struct sockaddr const *addr6(struct sockaddr_in6 *sin6,
+	char const *text) {
+	memset(sin6, 0, sizeof *sin6);
+	sin6->sin6_family = AF_INET6;
+	int _ = inet_pton(AF_INET6, text, &sin6->sin6_addr);
+	assert(_ == 1);
+
+	return (struct sockaddr const *) sin6;
+}
+
+int main(int argc, char *argv[]) {
+	struct ny ny;
+	ny_init(&ny);
+
+	struct ny_admit admit;
+	int _ = ny_admit_init(&admit, &ny, 64);
+	assert(_ == 0);
+	assert(admit.slots != NULL);
+
+	struct sockaddr_in6 sin6;
+	uint32_t slot[4];
+
+	/* Connection limit per prefix */
+	admit.maxcon = 2;
+	assert(ny_admit_acquire(&admit, addr6(&sin6, "2001:db8::1"), 1000.0, &slot[0]));
+	assert(ny_admit_acquire(&admit, addr6(&sin6, "2001:db8::2"), 1000.0, &slot[1]));
+	assert(slot[0] == slot[1]);
+	assert(!ny_admit_acquire(&admit, addr6(&sin6, "2001:db8::3"), 1000.0, &slot[2]));
+
+	/* Other prefix */
+	assert(ny_admit_acquire(&admit, addr6(&sin6, "2001:db8:0:1::1"), 1000.0, &slot[2]));
+	assert(slot[2] != slot[0]);
+
+	/* IPv4-mapped addresses are grouped per address */
+	assert(ny_admit_acquire(&admit, addr6(&sin6, "::ffff:192.0.2.1"), 1000.0, &slot[3]));
+	assert(slot[3] != slot[0] && slot[3] != slot[2]);
+
+	/* Released connections count no more */
+	ny_admit_release(&admit, slot[0]);
+	assert(ny_admit_acquire(&admit, addr6(&sin6, "2001:db8::3"), 1000.0, &slot[0]));
+
+	/* Connection rate per prefix */
+	admit.maxcon = 0;
+	admit.rate = 1.0;
+	admit.burst = 2;
+	assert(ny_admit_acquire(&admit, addr6(&sin6, "2001:db8:0:2::1"), 2000.0, &slot[0]));
+	assert(ny_admit_acquire(&admit, addr6(&sin6, "2001:db8:0:2::1"), 2000.0, &slot[0]));
+	assert(!ny_admit_acquire(&admit, addr6(&sin6, "2001:db8:0:2::1"), 2000.0, &slot[0]));
+	assert(ny_admit_acquire(&admit, addr6(&sin6, "2001:db8:0:2::1"), 2001.0, &slot[0]));
+
+	/* Connections rejected for the limit do not use up rate budget */
+	admit.maxcon = 1;
+	assert(ny_admit_acquire(&admit, addr6(&sin6, "2001:db8:0:3::1"), 3000.0, &slot[0]));
+	assert(!ny_admit_acquire(&admit, addr6(&sin6, "2001:db8:0:3::1"), 3000.0, &slot[1]));
+	ny_admit_release(&admit, slot[0]);
+	assert(ny_admit_acquire(&admit, addr6(&sin6, "2001:db8:0:3::1"), 3000.0, &slot[0]));
+	assert(!ny_admit_acquire(&admit, addr6(&sin6, "2001:db8:0:3::2"), 3000.0, &slot[1]));
+	ny_admit_release(&admit, slot[0]);
+	assert(!ny_admit_acquire(&admit, addr6(&sin6, "2001:db8:0:3::2"), 3000.0, &slot[1]));
+
+	/* Other address families are not tracked */
+	struct sockaddr unspec = { .sa_family = AF_UNIX };
+	assert(ny_admit_acquire(&admit, &unspec, 2001.0, &slot[0]));
+	assert(slot[0] == NY_ADMIT_NONE);
+
+	ny_admit_destroy(&admit);
+
+	return EXIT_SUCCESS;
+}
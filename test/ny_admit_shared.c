@@ -0,0 +1,52 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <sys/wait.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/admit.h>
+
+int main(int argc, char *argv[]) {
+	struct ny ny;
+	ny_init(&ny);
+
+	struct ny_admit admit;
+	int _ = ny_admit_init(&admit, &ny, 16);
+	assert(_ == 0);
+
+	admit.maxcon = 2;
+
+	struct sockaddr_in sin = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+	};
+
+	uint32_t slot;
+
+	/* Child process fills up the limit */
+	pid_t pid = fork();
+	assert(pid >= 0);
+	if (!pid) {
+		for (size_t iter = 0; iter < 2; ++iter)
+			if (!ny_admit_acquire(&admit, (struct sockaddr const *) &sin, 1.0,
+				&slot))
+				_exit(EXIT_FAILURE);
+
+		_exit(EXIT_SUCCESS);
+	}
+
+	int status;
+	assert(waitpid(pid, &status, 0) == pid);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+
+	/* Parent sees connections of child */
+	assert(!ny_admit_acquire(&admit, (struct sockaddr const *) &sin, 1.0,
+		&slot));
+
+	ny_admit_destroy(&admit);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,48 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/alloc.h>
+
+int main(int argc, char *argv[]) {
+	uint_least32_t const num = 65536;
+	uint_least16_t const len = 40;
+
+	uint8_t **ptr = calloc(num, sizeof (uint8_t *));
+	assert(ptr != NULL);
+
+	struct ny ny;
+	ny_init(&ny);
+
+	struct ny_alloc alloc;
+	int _ = ny_alloc_init_grow(&alloc, &ny, num, len);
+	assert(_ == 0);
+	assert(alloc.slabs != NULL);
+	assert(alloc.nslab > 1);
+
+	for (unsigned round = 0; round < 2; ++round) {
+		/* Acquire full capacity, growing the pool */
+		for (size_t iter = 0; iter < num; ++iter) {
+			ptr[iter] = ny_alloc_acquire(&alloc);
+			assert(ptr[iter] != NULL);
+			memset(ptr[iter], (uint8_t) iter, len);
+		}
+
+		/* Objects do not overlap */
+		for (size_t iter = 0; iter < num; ++iter)
+			for (size_t kter = 0; kter < len; ++kter)
+				assert(ptr[iter][kter] == (uint8_t) iter);
+
+		for (size_t iter = 0; iter < num; ++iter)
+			ny_alloc_release(&alloc, ptr[iter]);
+
+		/* Return unused slabs */
+		for (unsigned iter = 0; iter < 64; ++iter)
+			ny_alloc_trim(&alloc);
+	}
+
+	ny_alloc_destroy(&alloc);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,49 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/alloc.h>
+
+int main(int argc, char *argv[]) {
+	uint_least32_t const num = 65536;
+	uint_least16_t const len = 40;
+
+	struct ny ny;
+	ny_init(&ny);
+
+	struct ny_alloc alloc;
+	int _ = ny_alloc_init_huge(&alloc, &ny, num, len);
+	assert(_ == 0);
+	assert(alloc.huge);
+
+	/* Pool is rounded to huge page boundary and aligned to it */
+	assert(alloc.memsize % 2097152 == 0);
+	assert((uintptr_t) alloc.pool % 2097152 == 0);
+	assert(alloc.number >= num);
+
+	uint8_t **ptr = calloc(alloc.number, sizeof (uint8_t *));
+	assert(ptr != NULL);
+
+	/* Acquire full capacity */
+	for (size_t iter = 0; iter < alloc.number; ++iter) {
+		ptr[iter] = ny_alloc_acquire(&alloc);
+		assert(ptr[iter] != NULL);
+		memset(ptr[iter], (uint8_t) iter, len);
+	}
+
+	assert(ny_alloc_acquire(&alloc) == NULL);
+
+	/* Objects do not overlap */
+	for (size_t iter = 0; iter < alloc.number; ++iter)
+		for (size_t kter = 0; kter < len; ++kter)
+			assert(ptr[iter][kter] == (uint8_t) iter);
+
+	for (size_t iter = 0; iter < alloc.number; ++iter)
+		ny_alloc_release(&alloc, ptr[iter]);
+
+	ny_alloc_destroy(&alloc);
+	free(ptr);
+
+	return EXIT_SUCCESS;
+}
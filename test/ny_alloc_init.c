@@ -16,7 +16,9 @@ int main(int argc, char *argv[]) {
 	assert(_ == 0);
 	assert(alloc.pool != NULL);
 	assert(alloc.memsize % ny.page_size == 0);
-	assert(alloc.free != UINT32_MAX);
+	assert(alloc.free == UINT32_MAX);
+	assert(alloc.next == 0);
+	assert(alloc.number >= 1021);
 	assert(alloc.size >= 4);
 	assert(alloc.size % sizeof (void *) == 0);
 
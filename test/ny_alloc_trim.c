@@ -0,0 +1,72 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/alloc.h>
+
+int main(int argc, char *argv[]) {
+	uint_least32_t const num = 65536;
+	uint_least16_t const len = 40;
+
+	uint8_t **ptr = calloc(num, sizeof (uint8_t *));
+	assert(ptr != NULL);
+
+	struct ny ny;
+	ny_init(&ny);
+
+	struct ny_alloc alloc;
+	int _ = ny_alloc_init_grow(&alloc, &ny, num, len);
+	assert(_ == 0);
+	assert(alloc.nslab > 3);
+
+	uint32_t const perslab = UINT32_C(1) << alloc.shift;
+	uint8_t *const slab1 = alloc.pool + (size_t) perslab * alloc.size;
+	uint8_t *const slab2 = alloc.pool + (size_t) 2 * perslab * alloc.size;
+
+	/* Fill first three slabs */
+	for (size_t iter = 0; iter < 3 * perslab; ++iter) {
+		ptr[iter] = ny_alloc_acquire(&alloc);
+		assert(ptr[iter] != NULL);
+		memset(ptr[iter], 0xff, len);
+	}
+
+	assert(alloc.next == 3 * perslab);
+
+	/* Release whole second slab */
+	for (size_t iter = perslab; iter < 2 * perslab; ++iter)
+		ny_alloc_release(&alloc, ptr[iter]);
+
+	/* Return it to the system once unused for long enough */
+	for (unsigned iter = 0; iter < 64; ++iter)
+		ny_alloc_trim(&alloc);
+
+	assert(alloc.nreturn == 1);
+	assert(alloc.free == UINT32_MAX);
+
+	/* Returned slab is reused before memory never acquired */
+	for (size_t iter = perslab; iter < 2 * perslab; ++iter) {
+		ptr[iter] = ny_alloc_acquire(&alloc);
+		assert(ptr[iter] >= slab1 && ptr[iter] < slab2);
+		memset(ptr[iter], (uint8_t) iter, len);
+	}
+
+	assert(alloc.nreturn == 0);
+	assert(alloc.next == 3 * perslab);
+
+	/* Objects do not overlap */
+	for (size_t iter = perslab; iter < 2 * perslab; ++iter)
+		for (size_t kter = 0; kter < len; ++kter)
+			assert(ptr[iter][kter] == (uint8_t) iter);
+
+	/* Slabs in use are kept */
+	for (unsigned iter = 0; iter < 64; ++iter)
+		ny_alloc_trim(&alloc);
+
+	assert(alloc.nreturn == 0);
+
+	ny_alloc_destroy(&alloc);
+	free(ptr);
+
+	return EXIT_SUCCESS;
+}
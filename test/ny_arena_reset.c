@@ -0,0 +1,73 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/alloc.h>
+#include <nyanttp/arena.h>
+
+int main(int argc, char *argv[]) {
+	uint_least32_t const num = 4;
+	uint_least16_t const len = 1024;
+	size_t const iters = 200;
+
+	uint8_t *ptr[200];
+
+	struct ny ny;
+	ny_init(&ny);
+
+	struct ny_alloc alloc;
+	int _ = ny_alloc_init(&alloc, &ny, num, len);
+	assert(_ == 0);
+
+	struct ny_arena arena;
+	ny_arena_init(&arena, &ny, &alloc);
+
+	for (unsigned round = 0; round < 2; ++round) {
+		/* Allocate beyond the first chunk */
+		for (size_t iter = 0; iter < iters; ++iter) {
+			ptr[iter] = ny_arena_alloc(&arena, iter % 17 + 1);
+			assert(ptr[iter] != NULL);
+			assert((uintptr_t) ptr[iter] % _Alignof (max_align_t) == 0);
+			memset(ptr[iter], (uint8_t) iter, iter % 17 + 1);
+		}
+
+		/* Memory too large for a chunk is mapped directly */
+		uint8_t *large = ny_arena_alloc(&arena, 3 * len);
+		assert(large != NULL);
+		memset(large, 0xff, 3 * len);
+
+		/* Allocations do not overlap */
+		for (size_t iter = 0; iter < iters; ++iter)
+			for (size_t kter = 0; kter < iter % 17 + 1; ++kter)
+				assert(ptr[iter][kter] == (uint8_t) iter);
+
+		uint8_t *first = ptr[0];
+
+		/* Reset keeps only the first chunk */
+		ny_arena_reset(&arena);
+		assert(arena.large == NULL);
+
+		ptr[0] = ny_arena_alloc(&arena, 1);
+		assert(ptr[0] == first);
+
+		ny_arena_reset(&arena);
+	}
+
+	/* Chunk pool can be exhausted */
+	for (size_t iter = 0; iter < alloc.number; ++iter)
+		assert(ny_arena_alloc(&arena, len / 2) != NULL);
+	assert(ny_arena_alloc(&arena, len / 2) == NULL);
+
+	/* Destroying returns all chunks */
+	ny_arena_destroy(&arena);
+
+	for (size_t iter = 0; iter < alloc.number; ++iter)
+		assert(ny_alloc_acquire(&alloc) != NULL);
+
+	ny_alloc_destroy(&alloc);
+
+	return EXIT_SUCCESS;
+}
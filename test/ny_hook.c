@@ -0,0 +1,33 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include <nyanttp/ny.h>
+
+int main(int argc, char *argv[]) {
+	struct ny ny;
+	ny_init(&ny);
+	assert(ny.hook == NULL);
+
+	struct ny_hook a = { .worker = NULL }, b = { .worker = NULL };
+	ny_hook_add(&ny, &a);
+	ny_hook_add(&ny, &b);
+	assert(ny.hook == &b);
+	assert(b.next == &a);
+	assert(a.next == NULL);
+
+	ny_hook_remove(&ny, &a);
+	assert(ny.hook == &b);
+	assert(b.next == NULL);
+
+	/* Removing an unregistered hook has no effect */
+	ny_hook_remove(&ny, &a);
+	assert(ny.hook == &b);
+
+	ny_hook_remove(&ny, &b);
+	assert(ny.hook == NULL);
+
+	int _ = ny_run(&ny, 2);
+	assert(_ == 0);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <nyanttp/ny.h>
+
+static int listener(struct sockaddr_in *sin) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	assert(fd >= 0);
+
+	memset(sin, 0, sizeof *sin);
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	int _ = bind(fd, (struct sockaddr *) sin, sizeof *sin);
+	assert(_ == 0);
+
+	socklen_t len = sizeof *sin;
+	_ = getsockname(fd, (struct sockaddr *) sin, &len);
+	assert(_ == 0);
+
+	return fd;
+}
+
+int main(int argc, char *argv[]) {
+	struct sockaddr_in sin[2];
+	int fd[2] = { listener(&sin[0]), listener(&sin[1]) };
+
+	/* Keep number from being reused once closed */
+	int _ = dup2(fd[1], 200);
+	assert(_ == 200);
+	close(fd[1]);
+	fd[1] = 200;
+
+	/* Oversized list is an error */
+	char value[1024];
+	memset(value, '1', sizeof value - 1);
+	value[sizeof value - 1] = '\0';
+	setenv("NY_INHERIT", value, 1);
+	errno = 0;
+	assert(ny_inherit((struct sockaddr *) &sin[0], sizeof sin[0]) < 0);
+	assert(errno == E2BIG);
+
+	/* Take over first socket */
+	snprintf(value, sizeof value, "%d,%d", fd[0], fd[1]);
+	setenv("NY_INHERIT", value, 1);
+	assert(ny_inherit((struct sockaddr *) &sin[0], sizeof sin[0]) == fd[0]);
+
+	/* Remaining socket stays listed, neither is passed on exec */
+	snprintf(value, sizeof value, "%d", fd[1]);
+	assert(!strcmp(getenv("NY_INHERIT"), value));
+	assert(fcntl(fd[0], F_GETFD) & FD_CLOEXEC);
+	assert(fcntl(fd[1], F_GETFD) & FD_CLOEXEC);
+
+	/* Sockets nobody took over are closed by ny_run() */
+	struct ny ny;
+	ny_init(&ny);
+	_ = ny_run(&ny, 1);
+	assert(_ == 0);
+	assert(!getenv("NY_INHERIT"));
+	assert(fcntl(fd[1], F_GETFD) < 0 && errno == EBADF);
+
+	close(fd[0]);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,33 @@
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <nyanttp/ny.h>
+
+static unsigned *spawned;
+
+/* Fail the first two attempts to start a worker */
+static int worker(struct ny_hook *restrict hook, unsigned index) {
+	return __sync_add_and_fetch(spawned, 1) <= 2 ? -1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+	spawned = mmap(NULL, sizeof *spawned, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	assert(spawned != MAP_FAILED);
+	*spawned = 0;
+
+	struct ny ny;
+	ny_init(&ny);
+
+	struct ny_hook hook = { .worker = worker };
+	ny_hook_add(&ny, &hook);
+
+	int _ = ny_run(&ny, 1);
+	assert(_ == 0);
+	assert(*spawned == 3);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,39 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include <nyanttp/ny.h>
+
+#define NTHREAD 4
+
+static struct ny *parent;
+
+static int setup(struct ny *restrict ny, unsigned worker) {
+	assert(ny != parent);
+	assert(ny->loop != NULL);
+	assert(ny->loop != parent->loop);
+	assert(ny->hook == NULL);
+	assert(worker < NTHREAD);
+
+	/* Shared data is inherited from the parent */
+	unsigned *seen = ny->data;
+	seen[worker] = worker + 1;
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned seen[NTHREAD] = { 0 };
+
+	struct ny ny;
+	ny_init(&ny);
+	ny.data = seen;
+	parent = &ny;
+
+	int _ = ny_run_threads(&ny, NTHREAD, setup);
+	assert(_ == 0);
+
+	for (unsigned iter = 0; iter < NTHREAD; ++iter)
+		assert(seen[iter] == iter + 1);
+
+	return EXIT_SUCCESS;
+}
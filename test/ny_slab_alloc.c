@@ -0,0 +1,61 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/slab.h>
+
+int main(int argc, char *argv[]) {
+	size_t const sizes[] = { 0, 1, 64, 65, 500, 4096, 4097, 32768, 32769, 100000 };
+	size_t const num = sizeof sizes / sizeof *sizes;
+
+	uint8_t *ptr[sizeof sizes / sizeof *sizes];
+
+	struct ny ny;
+	ny_init(&ny);
+
+	struct ny_slab slab;
+	int _ = ny_slab_init(&slab, &ny, 1 << 20);
+	assert(_ == 0);
+
+	/* Allocate all sizes */
+	for (size_t iter = 0; iter < num; ++iter) {
+		ptr[iter] = ny_slab_alloc(&slab, sizes[iter]);
+		assert(ptr[iter] != NULL);
+		memset(ptr[iter], (uint8_t) iter, sizes[iter]);
+	}
+
+	/* Check for overlaps */
+	for (size_t iter = 0; iter < num; ++iter)
+		for (size_t kter = 0; kter < sizes[iter]; ++kter)
+			assert(ptr[iter][kter] == (uint8_t) iter);
+
+	/* Statistics */
+	assert(slab.classes[0].live == 3);
+	assert(slab.classes[1].live == 1);
+	assert(slab.classes[NY_SLAB_CLASSES - 1].live == 1);
+	assert(slab.nlarge == 2);
+	assert(slab.large == 32769 + 100000);
+
+	/* Resizing keeps contents */
+	ptr[4] = ny_slab_realloc(&slab, ptr[4], 500, 512);
+	assert(ptr[4] != NULL);
+	ptr[4] = ny_slab_realloc(&slab, ptr[4], 512, 40000);
+	assert(ptr[4] != NULL);
+	for (size_t kter = 0; kter < 500; ++kter)
+		assert(ptr[4][kter] == 4);
+	assert(slab.classes[3].live == 0);
+	ny_slab_free(&slab, ptr[4], 40000);
+
+	for (size_t iter = 0; iter < num; ++iter)
+		if (iter != 4)
+			ny_slab_free(&slab, ptr[iter], sizes[iter]);
+
+	for (unsigned class = 0; class < NY_SLAB_CLASSES; ++class)
+		assert(slab.classes[class].live == 0);
+	assert(slab.large == 0);
+
+	ny_slab_destroy(&slab);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/tcp.h>
+
+static struct ny_tcp tcp;
+
+/* Connections and ticks at which they timed out */
+static struct ny_tcp_con *cons[3];
+static uint32_t expired[3];
+static bool keep;
+
+static bool timeout(struct ny_tcp_con *restrict con) {
+	for (size_t iter = 0; iter < 3; ++iter) {
+		if (cons[iter] == con)
+			expired[iter] = tcp.tick;
+	}
+
+	return keep && con == cons[2];
+}
+
+static void destroyed(struct ny_tcp_con *restrict con) {
+	for (size_t iter = 0; iter < 3; ++iter) {
+		if (cons[iter] == con)
+			cons[iter] = NULL;
+	}
+}
+
+/* Advance timing wheel without waiting for the timer */
+static void tick(struct ny *ny) {
+	tcp.timer.cb(ny->loop, &tcp.timer, EV_TIMER);
+}
+
+int main(int argc, char *argv[]) {
+	/* Timeout rounded up to whole ticks plus the partial current tick */
+	uint32_t ticks = NY_TCP_TIMEOUT / NY_TCP_WHEEL_TICK;
+	if (ticks * NY_TCP_WHEEL_TICK < NY_TCP_TIMEOUT)
+		++ticks;
+	++ticks;
+
+	struct ny ny;
+	int _ = ny_init(&ny);
+	assert(_ == 0);
+
+	_ = ny_tcp_init(&tcp, &ny, NULL, NULL, 16);
+	assert(_ == 0);
+
+	tcp.con_timeout = timeout;
+	tcp.con_destroy = destroyed;
+
+	struct sockaddr_un address = { .sun_family = AF_UNIX };
+	strcpy(address.sun_path, "ny_tcp_timeout.sock");
+	unlink(address.sun_path);
+
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	assert(sock >= 0);
+
+	_ = bind(sock, (struct sockaddr *) &address, sizeof address);
+	assert(_ == 0);
+
+	_ = listen(sock, 3);
+	assert(_ == 0);
+
+	/* Open connections through the TCP context */
+	int peer[3];
+	for (size_t iter = 0; iter < 3; ++iter) {
+		cons[iter] = ny_tcp_connect(&tcp, (struct sockaddr *) &address,
+			sizeof address);
+		assert(cons[iter] != NULL);
+
+		peer[iter] = accept(sock, NULL, NULL);
+		assert(peer[iter] >= 0);
+	}
+
+	close(sock);
+	unlink(address.sun_path);
+
+	assert(tcp.ncon == 3);
+
+	uint32_t const start = tcp.tick;
+
+	/* Push back second connection by touching it after a few ticks */
+	for (uint32_t iter = 0; iter < 10; ++iter)
+		tick(&ny);
+
+	ny_tcp_con_touch(cons[1]);
+
+	/* Third connection stays open after timing out */
+	keep = true;
+
+	/* Nothing expires before the timeout */
+	while (tcp.tick - start < ticks - 1)
+		tick(&ny);
+
+	assert(expired[0] == 0 && expired[1] == 0 && expired[2] == 0);
+	assert(tcp.ncon == 3);
+
+	/* Untouched connections expire after exactly the timeout */
+	tick(&ny);
+	assert(expired[0] == start + ticks);
+	assert(expired[1] == 0);
+	assert(expired[2] == start + ticks);
+	assert(cons[0] == NULL);
+	assert(tcp.ncon == 2);
+
+	/* Touched connection expires one timeout after the touch */
+	keep = false;
+	while (tcp.tick - start < 10 + ticks - 1)
+		tick(&ny);
+
+	assert(expired[1] == 0);
+	assert(cons[1] != NULL);
+
+	tick(&ny);
+	assert(expired[1] == start + 10 + ticks);
+	assert(cons[1] == NULL);
+
+	/* Kept connection expires again one timeout later */
+	while (tcp.tick - start < 2 * ticks)
+		tick(&ny);
+
+	assert(expired[2] == start + 2 * ticks);
+	assert(cons[2] == NULL);
+	assert(tcp.ncon == 0);
+
+	for (size_t iter = 0; iter < 3; ++iter)
+		close(peer[iter]);
+
+	ny_tcp_destroy(&tcp);
+	ny_destroy(&ny);
+
+	return EXIT_SUCCESS;
+}
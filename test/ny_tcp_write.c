@@ -0,0 +1,170 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <nyanttp/ny.h>
+#include <nyanttp/tcp.h>
+
+/* Receive whatever is available without blocking */
+static size_t drain(int fd, uint8_t *buffer, size_t length) {
+	size_t total = 0;
+
+	while (total < length) {
+		ssize_t got = recv(fd, buffer + total, length - total, MSG_DONTWAIT);
+		if (got < 0) {
+			assert(errno == EAGAIN || errno == EWOULDBLOCK);
+			break;
+		}
+
+		assert(got > 0);
+		total += got;
+	}
+
+	return total;
+}
+
+int main(int argc, char *argv[]) {
+	size_t const length = 49152;
+
+	uint8_t *data = malloc(length), *recvd = malloc(length + 1);
+	assert(data != NULL && recvd != NULL);
+
+	for (size_t iter = 0; iter < length; ++iter)
+		data[iter] = iter * 7 + iter / 251;
+
+	struct ny ny;
+	int _ = ny_init(&ny);
+	assert(_ == 0);
+
+	struct ny_tcp tcp;
+	_ = ny_tcp_init(&tcp, &ny, NULL, NULL, 4);
+	assert(_ == 0);
+
+	struct sockaddr_un address = { .sun_family = AF_UNIX };
+	strcpy(address.sun_path, "ny_tcp_write.sock");
+	unlink(address.sun_path);
+
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	assert(sock >= 0);
+
+	_ = bind(sock, (struct sockaddr *) &address, sizeof address);
+	assert(_ == 0);
+
+	_ = listen(sock, 1);
+	assert(_ == 0);
+
+	struct ny_tcp_con *con = ny_tcp_connect(&tcp,
+		(struct sockaddr *) &address, sizeof address);
+	assert(con != NULL);
+
+	int peer = accept(sock, NULL, NULL);
+	assert(peer >= 0);
+
+	close(sock);
+	unlink(address.sun_path);
+
+	/* Keep socket buffer well below the amount written */
+	int size = 4096;
+	_ = setsockopt(con->io.fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof size);
+	assert(_ == 0);
+
+	/* Queue a few bytes while connecting, then fail to queue more for lack
+	 * of segments */
+	_ = ny_tcp_con_write(con, data, 3);
+	assert(_ == 0);
+	assert(con->queued == 3);
+
+	struct ny_tcp_seg *out = con->out, *last = con->last;
+	assert(out != NULL && out == last);
+
+	void *held[256];
+	size_t nheld = 0;
+	while ((held[nheld] = ny_alloc_acquire(&tcp.alloc_seg)))
+		++nheld;
+
+	assert(nheld >= 2 && nheld < 256);
+	ny_alloc_release(&tcp.alloc_seg, held[--nheld]);
+	ny_alloc_release(&tcp.alloc_seg, held[--nheld]);
+
+	struct iovec vector[] = {
+		{ .iov_base = data + 3, .iov_len = 1000 },
+		{ .iov_base = data + 1003, .iov_len = 8192 }
+	};
+
+	_ = ny_tcp_con_write_vec(con, vector, 2);
+	assert(_ != 0);
+	assert(ny.error.domain == NY_ERROR_DOMAIN_ERRNO);
+	assert(ny.error.code == ENOBUFS);
+
+	/* Queue is unchanged and appended segments are back in the pool */
+	assert(con->out == out && con->last == last);
+	assert(con->queued == 3);
+
+	held[nheld] = ny_alloc_acquire(&tcp.alloc_seg);
+	assert(held[nheld++] != NULL);
+	held[nheld] = ny_alloc_acquire(&tcp.alloc_seg);
+	assert(held[nheld++] != NULL);
+	assert(ny_alloc_acquire(&tcp.alloc_seg) == NULL);
+
+	while (nheld)
+		ny_alloc_release(&tcp.alloc_seg, held[--nheld]);
+
+	/* Only the bytes queued before the failed call are sent */
+	for (unsigned iter = 0; iter < 4; ++iter)
+		ev_run(ny.loop, EVRUN_NOWAIT);
+
+	assert(!con->connecting);
+	assert(con->queued == 0);
+	assert(drain(peer, recvd, length) == 3);
+	assert(memcmp(recvd, data, 3) == 0);
+
+	/* Queue more than the socket takes at once */
+	for (size_t offset = 3; offset < length; offset += 4000) {
+		size_t chunk = length - offset < 4000 ? length - offset : 4000;
+		_ = ny_tcp_con_write(con, data + offset, chunk);
+		assert(_ == 0);
+	}
+
+	assert(con->queued == length - 3);
+
+	/* Read slowly while the rest is written as the socket drains */
+	size_t total = 3;
+	bool blocked = false;
+	for (unsigned iter = 0; iter < 4096 && total < length; ++iter) {
+		ev_run(ny.loop, EVRUN_NOWAIT);
+
+		if (con->blocked) {
+			blocked = true;
+			assert(con->queued > 0);
+		}
+
+		total += drain(peer, recvd + total, 1024 < length - total ?
+			1024 : length - total);
+	}
+
+	assert(blocked);
+	assert(total == length);
+	assert(memcmp(recvd, data, length) == 0);
+	assert(con->queued == 0);
+	assert(con->out == NULL);
+
+	/* Nothing else arrives */
+	ev_run(ny.loop, EVRUN_NOWAIT);
+	assert(drain(peer, recvd, 1) == 0);
+
+	ny_tcp_con_destroy(con);
+	close(peer);
+
+	ny_tcp_destroy(&tcp);
+	ny_destroy(&ny);
+
+	free(recvd);
+	free(data);
+
+	return EXIT_SUCCESS;
+}